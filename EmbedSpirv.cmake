@@ -0,0 +1,107 @@
+# Compiles GLSL shaders to SPIR-V and embeds the result into an executable.
+#
+#   include("../EmbedSpirv.cmake")
+#   embed_shaders(<target> shader.vert shader.frag ...)
+#
+# Each shader is compiled with glslangValidator, and all of them are written
+# as constexpr uint32_t arrays to a generated EmbeddedShaders.hpp that the
+# target can include. The header defines EmbeddedShaders::shaders, which
+# ShaderRegistry::find() searches by the shader's file name at compile time.
+#
+# The same file is run in script mode (cmake -P) to generate the header.
+
+if(NOT CMAKE_SCRIPT_MODE_FILE)
+
+set(EMBED_SPIRV_SCRIPT "${CMAKE_CURRENT_LIST_FILE}")
+
+function(embed_shaders TARGET)
+  set(generatedDir "${CMAKE_CURRENT_BINARY_DIR}/generated")
+  set(header "${generatedDir}/EmbeddedShaders.hpp")
+  set(spirvFiles)
+
+  foreach(shader ${ARGN})
+    get_filename_component(name "${shader}" NAME)
+    set(source "${CMAKE_CURRENT_SOURCE_DIR}/${shader}")
+    set(spirv "${CMAKE_CURRENT_BINARY_DIR}/${name}.spv")
+
+    add_custom_command(OUTPUT "${spirv}"
+      COMMAND glslangValidator -V -o "${spirv}" "${source}"
+      DEPENDS "${source}"
+      VERBATIM
+      )
+
+    list(APPEND spirvFiles "${spirv}")
+  endforeach()
+
+  # Semicolons would split the list when passed on the command line
+  string(REPLACE ";" "|" inputs "${spirvFiles}")
+
+  add_custom_command(OUTPUT "${header}"
+    COMMAND "${CMAKE_COMMAND}" "-DINPUTS=${inputs}" "-DOUTPUT=${header}"
+      -P "${EMBED_SPIRV_SCRIPT}"
+    DEPENDS ${spirvFiles} "${EMBED_SPIRV_SCRIPT}"
+    VERBATIM
+    )
+
+  target_sources(${TARGET} PRIVATE "${header}")
+  target_include_directories(${TARGET} PRIVATE "${generatedDir}")
+endfunction()
+
+else()
+
+string(REPLACE "|" ";" inputs "${INPUTS}")
+
+set(arrays "")
+set(entries "")
+
+foreach(input ${inputs})
+  get_filename_component(fileName "${input}" NAME)
+  string(REGEX REPLACE "\\.spv$" "" name "${fileName}")
+  string(MAKE_C_IDENTIFIER "${name}" identifier)
+
+  file(READ "${input}" hex HEX)
+  string(LENGTH "${hex}" length)
+  math(EXPR remainder "${length} % 8")
+
+  if(length EQUAL 0 OR NOT remainder EQUAL 0)
+    message(FATAL_ERROR "${input} is not a SPIR-V module")
+  endif()
+
+  # glslangValidator writes words in host byte order, which is little endian
+  # on every platform the samples target
+  string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " words "${hex}")
+  set(word "0x[0-9a-f]+, ")
+  string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word})" "\\1\n    "
+    words "${words}")
+  string(REPLACE ", \n" ",\n" words "${words}")
+  string(REGEX REPLACE ",\n    $" "," words "${words}")
+  string(REGEX REPLACE ", $" "," words "${words}")
+
+  set(arrays "${arrays}constexpr std::uint32_t ${identifier}[] = {\n    ${words}\n};\n\n")
+  set(entries "${entries}    { \"${name}\", ${identifier}, sizeof(${identifier}) },\n")
+endforeach()
+
+file(WRITE "${OUTPUT}.tmp"
+  "// Generated by EmbedSpirv.cmake; do not edit\n"
+  "#pragma once\n"
+  "\n"
+  "#include <cstdint>\n"
+  "\n"
+  "#include \"ShaderRegistry.hpp\"\n"
+  "\n"
+  "namespace EmbeddedShaders {\n"
+  "\n"
+  "${arrays}"
+  "constexpr EmbeddedShader shaders[] = {\n"
+  "${entries}"
+  "};\n"
+  "\n"
+  "} // namespace EmbeddedShaders\n"
+  )
+
+# Leave the header untouched when nothing changed to avoid rebuilds
+execute_process(COMMAND "${CMAKE_COMMAND}" -E copy_if_different
+  "${OUTPUT}.tmp" "${OUTPUT}")
+file(REMOVE "${OUTPUT}.tmp")
+
+endif()
@@ -1,41 +1,135 @@
-#define NOMINMAX
-#define STRICT
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-
 #include <vulkan/vulkan.hpp>
 
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
-#include <fstream>
 #include <functional>
-#include <iterator>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
 #include "glm/vec4.hpp"
 
 #include "Defer.hpp"
-#include "WindowsHelper.hpp"
-
+#include "EmbeddedShaders.hpp"
+#include "FrameStats.hpp"
+#include "FixedStepSimulation.hpp"
+#include "FrustumCuller.hpp"
+#include "GpuProfiler.hpp"
+#include "LatencyStats.hpp"
+#include "Log.hpp"
+#include "MemoryAllocator.hpp"
+#include "PipelineCache.hpp"
+#include "Platform.hpp"
+#include "PresentMode.hpp"
+#include "RecordingScheduler.hpp"
+#include "RenderGraph.hpp"
+#include "TaskGraph.hpp"
+#include "TransientAttachmentPool.hpp"
+#include "UniformRing.hpp"
+#include "Uploader.hpp"
+#include "VertexFormat.hpp"
+
+// Per-frame parameters of animate.comp and cull.comp
 struct UBO {
-  float scale;
+  float time;
+  float deltaTime;
+  std::uint32_t instanceCount;
+  std::uint32_t reset;
+  float meshRadius;
+  std::uint32_t indexCount;
+  glm::vec2 gridOffset;
+  glm::vec4 frustumPlanes[6];
+};
+
+// What the CPU simulates, in fixed steps on its own thread. The instances
+// themselves are animated by animate.comp from the simulated time.
+struct SimulationState {
+  float time;
+  glm::vec2 gridOffset;
 };
 
+// 12 bytes instead of two vec4s
 struct Vertex {
-  glm::vec4 position;
+  Snorm16x4 position;
+  Unorm8x4 color;
+};
+
+struct Instance {
+  // Offset in xy, scale in z and rotation in radians in w
+  glm::vec4 transform;
   glm::vec4 color;
 };
 
-int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
+template <>
+struct VertexAttributeFormat<glm::vec4>
+    : std::integral_constant<vk::Format, vk::Format::eR32G32B32A32Sfloat> {};
+
+int main(int argc, char* argv[]) {
+  const auto startupBegin = std::chrono::steady_clock::now();
+
+  const auto argument = [&](int index, std::uint32_t defaultValue) {
+    return argc > index ? static_cast<std::uint32_t>(std::stoul(argv[index]))
+                        : defaultValue;
+  };
+
+#if defined(HEADLESS)
+  // Number of frames to render before reporting timings
+  const auto frameCount = argument(1, 1000);
+  const int firstOption = 2;
+#else
+  const int firstOption = 1;
+#endif
+
+  // Number of frames the CPU may record ahead of the GPU
+  const auto framesInFlight = std::max(argument(firstOption, 2), 1u);
+
+  // Frames per second to limit rendering to, or 0 for no limit
+  const auto maxFrameRate = argument(firstOption + 1, 0);
+
+  // Number of triangles, culled on the GPU and drawn with indirect draws
+  const auto instanceCount = std::max(argument(firstOption + 2, 1), 1u);
+
+  // Threads recording the draws, each into its own secondary command buffer
+  const auto threadCount =
+      argument(firstOption + 3, std::thread::hardware_concurrency());
+
+  // Nonzero to cull batches on the CPU even where the GPU could draw all of
+  // them with a few indirect draws
+  const bool forceCpuCulling = argument(firstOption + 4, 0) != 0;
+
+#if !defined(HEADLESS)
+  // How the swapchain presents: fifo, mailbox or immediate. Modes the
+  // surface lacks fall back to fifo.
+  const auto wantedPresentMode = PresentMode::parse(
+      argc > firstOption + 5 ? argv[firstOption + 5] : "fifo");
+
+  // Swapchain images to ask for. With fifo, fewer images queue fewer frames
+  // ahead of the display.
+  const auto wantedImageCount = argument(firstOption + 6, 3);
+#endif
+
+  Platform platform([&] {
+    PlatformConfig config;
+
+    if (maxFrameRate > 0) {
+      config.loopMode = LoopMode::eLimited;
+      config.maxFrameRate = maxFrameRate;
+    }
+
+    return config;
+  }());
+
   // Create an vulkan instance
   const auto instance = [] {
     const auto extensions = [] {
-      std::vector<const char*> wanted = {VK_KHR_SURFACE_EXTENSION_NAME,
-                                         VK_KHR_WIN32_SURFACE_EXTENSION_NAME};
+      auto wanted = Platform::instanceExtensions();
 
       const auto props = vk::enumerateInstanceExtensionProperties();
 
@@ -84,15 +178,13 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
 
   const auto destroyInstance = Defer([&] { instance.destroy(); });
 
-  // Create a window
-  const auto hWnd = WindowsHelper::createWindow(hInstance);
-  ShowWindow(hWnd, SW_SHOWDEFAULT);
-
+#if !defined(HEADLESS)
   // Create a surface
-  const auto surface = instance.createWin32SurfaceKHR({{}, hInstance, hWnd});
+  const auto surface = platform.createSurface(instance);
 
   const auto destroySurface =
       Defer([&] { instance.destroySurfaceKHR(surface); });
+#endif
 
   // Pick a GPU
   const auto& gpu = [&instance] {
@@ -107,23 +199,49 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
 
   const auto queueFamilyProperties = gpu.getQueueFamilyProperties();
 
-  // Find appropreate queue family indices
+  // Find appropreate queue family indices. The animation is computed on the
+  // graphics queue, right before it is drawn.
   const auto graphicsQueueFamilyIndex = [&] {
+    const auto wanted =
+        vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute;
 
+    const auto i = std::distance(
+        queueFamilyProperties.cbegin(),
+        std::find_if(queueFamilyProperties.cbegin(),
+                     queueFamilyProperties.cend(), [&](const auto& prop) {
+                       return (prop.queueFlags & wanted) == wanted;
+                     }));
+
+    if (i == queueFamilyProperties.size()) {
+      throw std::runtime_error("No graphics and compute operation support");
+    }
+
+    return static_cast<std::uint32_t>(i);
+  }();
+
+  // Uploads go through a transfer-only queue family when there is one, which
+  // usually maps to a dedicated copy engine
+  const auto transferQueueFamilyIndex = [&] {
     const auto i = std::distance(
         queueFamilyProperties.cbegin(),
         std::find_if(queueFamilyProperties.cbegin(),
                      queueFamilyProperties.cend(), [](const auto& prop) {
-                       return prop.queueFlags & vk::QueueFlagBits::eGraphics;
+                       return (prop.queueFlags & vk::QueueFlagBits::eTransfer) &&
+                              !(prop.queueFlags &
+                                (vk::QueueFlagBits::eGraphics |
+                                 vk::QueueFlagBits::eCompute));
                      }));
 
     if (i == queueFamilyProperties.size()) {
-      throw std::runtime_error("No graphics operation support");
+      return graphicsQueueFamilyIndex;
     }
 
     return static_cast<std::uint32_t>(i);
   }();
 
+#if defined(HEADLESS)
+  const bool separatePresentQueue = false;
+#else
   const auto presentQueueFamilyIndex = [&] {
     std::vector<vk::Bool32> supportPresent;
 
@@ -148,6 +266,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
 
   const bool separatePresentQueue =
       graphicsQueueFamilyIndex != presentQueueFamilyIndex;
+#endif
 
   // Pick a logical device
   const auto device = [&] {
@@ -155,15 +274,31 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
     std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos{
         {{}, graphicsQueueFamilyIndex, 1, &graphicsQueuePriority}};
 
+#if !defined(HEADLESS)
+    const float presentQueuePriority = 0.0f;
     if (separatePresentQueue) {
-      const float presentQueuePriority = 0.0f;
       queueCreateInfos.emplace_back(vk::DeviceQueueCreateFlags{},
                                     presentQueueFamilyIndex, 1,
                                     &presentQueuePriority);
     }
+#endif
+
+    const float transferQueuePriority = 0.0f;
+    if (std::none_of(queueCreateInfos.cbegin(), queueCreateInfos.cend(),
+                     [&](const auto& info) {
+                       return info.queueFamilyIndex == transferQueueFamilyIndex;
+                     })) {
+      queueCreateInfos.emplace_back(vk::DeviceQueueCreateFlags{},
+                                    transferQueueFamilyIndex, 1,
+                                    &transferQueuePriority);
+    }
 
     const auto extensions = [&] {
+#if defined(HEADLESS)
+      std::vector<const char*> wanted;
+#else
       std::vector<const char*> wanted = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+#endif
 
       const auto props = gpu.enumerateDeviceExtensionProperties();
 
@@ -215,8 +350,63 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
   const auto destroyDevice = Defer([&] { device.destroy(); });
 
   const auto graphicsQueue = device.getQueue(graphicsQueueFamilyIndex, 0);
+  const auto transferQueue = device.getQueue(transferQueueFamilyIndex, 0);
+#if !defined(HEADLESS)
   const auto presentQueue = device.getQueue(presentQueueFamilyIndex, 0);
+#endif
+
+  // Resources are sub-allocated from a few large memory blocks
+  MemoryAllocator allocator(device, gpu);
+
+  // Device-local buffers are filled through a staging ring
+  Uploader uploader(device, allocator, transferQueue, transferQueueFamilyIndex,
+                    graphicsQueueFamilyIndex);
 
+#if defined(HEADLESS)
+  // Render into offscreen images instead of swapchain images
+  const auto colorFormat = vk::Format::eB8G8R8A8Unorm;
+  const auto renderExtent = platform.extent();
+
+  // One image per frame in flight so that no frame overwrites an image the
+  // GPU is still rendering to
+  std::vector<vk::Image> colorImages;
+  std::vector<MemoryAllocator::Allocation> colorMemories;
+
+  const auto destroyColorImages = Defer([&] {
+    for (const auto& image : colorImages) {
+      device.destroyImage(image);
+    }
+    for (const auto& memory : colorMemories) {
+      allocator.free(memory);
+    }
+  });
+
+  const auto createColorImages = [&] {
+    for (std::uint32_t i = 0; i < framesInFlight; i++) {
+      colorImages.push_back(device.createImage(
+          {{},
+           vk::ImageType::e2D,
+           colorFormat,
+           {renderExtent.width, renderExtent.height, 1},
+           1,
+           1,
+           vk::SampleCountFlagBits::e1,
+           vk::ImageTiling::eOptimal,
+           vk::ImageUsageFlagBits::eColorAttachment |
+               vk::ImageUsageFlagBits::eTransferSrc,
+           vk::SharingMode::eExclusive,
+           0,
+           nullptr,
+           vk::ImageLayout::eUndefined}));
+
+      colorMemories.push_back(allocator.allocateImage(
+          colorImages.back(), vk::MemoryPropertyFlagBits::eDeviceLocal));
+    }
+  };
+
+  // Nothing presents the offscreen images, so leave them ready for readback
+  const auto colorFinalLayout = vk::ImageLayout::eTransferSrcOptimal;
+#else
   // Pick a surface format
   const auto& surfaceFormat = [&] {
     const auto formats = gpu.getSurfaceFormatsKHR(surface);
@@ -233,28 +423,29 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
     return *format;
   }();
 
+  const auto colorFormat = surfaceFormat.format;
+
   const auto surfaceCapabilities = gpu.getSurfaceCapabilitiesKHR(surface);
 
-  const auto swapchainExtent = [&] {
-    if (surfaceCapabilities.currentExtent.width == -1) {
-      const auto windowSize = WindowsHelper::getWindowSize(hWnd);
+  const auto presentMode = PresentMode::select(
+      gpu.getSurfacePresentModesKHR(surface), wantedPresentMode);
 
-      return vk::Extent2D{static_cast<std::uint32_t>(windowSize.cx),
-                          static_cast<std::uint32_t>(windowSize.cy)};
+  const auto renderExtent = [&] {
+    if (surfaceCapabilities.currentExtent.width == -1) {
+      return platform.extent();
     }
 
     return surfaceCapabilities.currentExtent;
   }();
 
-  // Create a swapchain
-  const auto swapchain = [&] {
+  const auto createSwapchain = [&] {
     std::vector<std::uint32_t> queueFamilyIndices = {graphicsQueueFamilyIndex};
     if (separatePresentQueue) {
       queueFamilyIndices.emplace_back(presentQueueFamilyIndex);
     }
 
-    const std::uint32_t expectedImageCount = static_cast<std::uint32_t>(3);
-    const std::uint32_t minImageCount = surfaceCapabilities.maxImageCount < expectedImageCount ? surfaceCapabilities.maxImageCount : expectedImageCount;
+    const auto minImageCount =
+        PresentMode::imageCount(surfaceCapabilities, wantedImageCount);
 
     vk::SharingMode imageSharingMode;
 
@@ -279,7 +470,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
          minImageCount,
          surfaceFormat.format,
          surfaceFormat.colorSpace,
-         swapchainExtent,
+         renderExtent,
          1,
          vk::ImageUsageFlagBits::eColorAttachment,
          imageSharingMode,
@@ -287,368 +478,362 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
          queueFamilyIndices.data(),
          preTransform,
          vk::CompositeAlphaFlagBitsKHR::eOpaque,
-         vk::PresentModeKHR::eFifo,
+         presentMode,
          true});
-  }();
+  };
+
+  vk::SwapchainKHR swapchain;
+  std::vector<vk::Image> colorImages;
 
   const auto destroySwapchain =
       Defer([&] { device.destroySwapchainKHR(swapchain); });
 
-  const auto swapchainImages = device.getSwapchainImagesKHR(swapchain);
+  const auto createColorImages = [&] {
+    swapchain = createSwapchain();
+    colorImages = device.getSwapchainImagesKHR(swapchain);
 
-  const auto swapchainImageViews = [&] {
-    std::vector<vk::ImageView> views;
+    Log::print("Presenting with %s and %zu images\n",
+               PresentMode::name(presentMode), colorImages.size());
+  };
 
-    for (const auto& image : swapchainImages) {
-      views.push_back(device.createImageView(
-          {{},
-           image,
-           vk::ImageViewType::e2D,
-           surfaceFormat.format,
-           {},
-           {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}}));
-    }
+  const auto colorFinalLayout = vk::ImageLayout::ePresentSrcKHR;
+#endif
 
-    return views;
-  }();
+  const auto depthFormat = vk::Format::eD32Sfloat;
 
-  const auto destroySwapchainImageViews = Defer([&] {
-    for (const auto& view : swapchainImageViews) {
+  // Views of the color images, which the frame graph renders into
+  std::vector<vk::ImageView> colorImageViews;
+
+  const auto destroyColorImageViews = Defer([&] {
+    for (const auto& view : colorImageViews) {
       device.destroyImageView(view);
     }
   });
 
-  // Setup Command buffers
-  const auto commandPool =
-      device.createCommandPool({{}, graphicsQueueFamilyIndex});
-
-  const auto destroyCommandPool =
-      Defer([&] { device.destroyCommandPool(commandPool); });
-
-  const auto commandBuffers = device.allocateCommandBuffers(
-      {commandPool, vk::CommandBufferLevel::ePrimary,
-       static_cast<std::uint32_t>(swapchainImages.size())});
-
-  const auto destroyCommandBuffers =
-      Defer([&] { device.freeCommandBuffers(commandPool, commandBuffers); });
+  // Setup Command buffers. Each frame in flight records its primary command
+  // buffer from its own pool, which is reset as a whole once the frame's
+  // fence has signaled. The draws go into secondary command buffers recorded
+  // by the scheduler.
+  std::vector<vk::CommandPool> commandPools;
+  std::vector<vk::CommandBuffer> commandBuffers;
 
-  // Create depth image
-  const auto depthFormat = vk::Format::eD32Sfloat;
-  const auto depthImages = [&] {
-    std::vector<vk::Image> v(swapchainImages.size());
-
-    std::generate(v.begin(), v.end(), [&] {
-      return device.createImage(
-          {{},
-           vk::ImageType::e2D,
-           depthFormat,
-           {swapchainExtent.width, swapchainExtent.height, 1},
-           1,
-           1,
-           vk::SampleCountFlagBits::e1,
-           vk::ImageTiling::eOptimal,
-           vk::ImageUsageFlagBits::eDepthStencilAttachment |
-               vk::ImageUsageFlagBits::eTransferDst,
-           vk::SharingMode::eExclusive,
-           0,
-           nullptr,
-           vk::ImageLayout::eUndefined});
-    });
-
-    return v;
-  }();
-
-  const auto destroyDepthImages = Defer([&] {
-    for (const auto& image : depthImages) {
-      device.destroyImage(image);
+  const auto destroyCommandPools = Defer([&] {
+    for (const auto& pool : commandPools) {
+      device.destroyCommandPool(pool);
     }
   });
 
-  const auto memoryProps = gpu.getMemoryProperties();
-
-  const auto getMemoryTypeIndex = [&](
-      const vk::MemoryRequirements& requirements,
-      const vk::MemoryPropertyFlags& propertyFlags) {
-
-    const auto i = std::distance(
-        memoryProps.memoryTypes,
-        std::find_if(memoryProps.memoryTypes,
-                     memoryProps.memoryTypes + VK_MAX_MEMORY_TYPES,
-                     [&](const auto& memoryType) {
-                       return (memoryType.propertyFlags & propertyFlags) ==
-                              propertyFlags;
-                     }));
-
-    if (i == VK_MAX_MEMORY_TYPES) {
-      throw new std::runtime_error("No appropreate memory type");
+  const auto createCommandBuffers = [&] {
+    for (std::uint32_t i = 0; i < framesInFlight; i++) {
+      commandPools.push_back(device.createCommandPool(
+          {vk::CommandPoolCreateFlagBits::eTransient,
+           graphicsQueueFamilyIndex}));
+
+      commandBuffers.push_back(
+          device
+              .allocateCommandBuffers({commandPools.back(),
+                                       vk::CommandBufferLevel::ePrimary, 1})
+              .at(0));
     }
-
-    return static_cast<std::uint32_t>(i);
-  };
-
-  const auto allocateImageMemory = [&](
-      const vk::Image& image, const vk::MemoryPropertyFlagBits& flagBit) {
-    const auto requirements = device.getImageMemoryRequirements(image);
-
-    const auto memoryTypeIndex = getMemoryTypeIndex(
-        requirements, vk::MemoryPropertyFlagBits::eDeviceLocal);
-
-    return device.allocateMemory({requirements.size, memoryTypeIndex});
-  };
-
-  const auto freeMemory = [&](const vk::DeviceMemory& memory) {
-    device.freeMemory(memory);
   };
 
-  const auto depthMemories = [&] {
-    std::vector<vk::DeviceMemory> v;
+  // The scene is drawn without a camera, so the frustum is the clip volume.
+  // The mesh's bounds are filled in with its data.
+  UBO ubo{0.0f,
+          0.0f,
+          instanceCount,
+          1,
+          0.0f,
+          0,
+          {},
+          {{1.0f, 0.0f, 0.0f, 1.0f},
+           {-1.0f, 0.0f, 0.0f, 1.0f},
+           {0.0f, 1.0f, 0.0f, 1.0f},
+           {0.0f, -1.0f, 0.0f, 1.0f},
+           {0.0f, 0.0f, 1.0f, 0.0f},
+           {0.0f, 0.0f, -1.0f, 1.0f}}};
+
+  // Uniform data is streamed through a persistently mapped buffer with one
+  // region per frame in flight, bound with dynamic offsets
+  UniformRing uniformRing(
+      device, allocator,
+      gpu.getProperties().limits.minUniformBufferOffsetAlignment,
+      64 * 1024, framesInFlight);
+
+  // Work groups of animate.comp and cull.comp. Each work group of
+  // cull.comp culls a batch of instances, drawn by one indirect command.
+  const std::uint32_t computeGroupSize = 64;
+  const std::uint32_t batchCount =
+      (instanceCount + computeGroupSize - 1) / computeGroupSize;
+
+  // Without drawIndirectFirstInstance, a draw command can't pick its batch's
+  // instances with firstInstance. Each batch is drawn on its own instead,
+  // with the visible instance buffer bound at the batch's offset.
+  const bool drawIndirectFirstInstance =
+      gpu.getFeatures().drawIndirectFirstInstance;
+
+  // Batches drawn by one indirect draw. Without multiDrawIndirect each batch
+  // needs its own.
+  const auto maxDrawIndirectCount =
+      gpu.getFeatures().multiDrawIndirect && drawIndirectFirstInstance
+          ? gpu.getProperties().limits.maxDrawIndirectCount
+          : 1u;
+
+  // When each batch is a draw of its own, the batches outside the view are
+  // culled on the CPU first so that they aren't recorded at all. Each draw
+  // then binds its batch's instances itself rather than relying on
+  // firstInstance.
+  const bool cpuCulling = forceCpuCulling || maxDrawIndirectCount == 1;
+
+  // Per-instance data stays on the GPU, where animate.comp advances it every
+  // frame, so the CPU time of a frame doesn't depend on the instance count.
+  // All frames in flight share it, as each frame's compute pass waits for
+  // the previous frame's draws.
+  const auto instanceBuffer = device.createBuffer(
+      {{}, sizeof(Instance) * instanceCount,
+       vk::BufferUsageFlagBits::eStorageBuffer, vk::SharingMode::eExclusive,
+       0, nullptr});
+
+  const auto instanceMemory = allocator.allocateBuffer(
+      instanceBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+  const auto destroyInstanceBuffer = Defer([&] {
+    device.destroyBuffer(instanceBuffer);
+    allocator.free(instanceMemory);
+  });
 
-    for (const auto& image : depthImages) {
-      auto memory =
-          allocateImageMemory(image, vk::MemoryPropertyFlagBits::eDeviceLocal);
-      device.bindImageMemory(image, memory, 0);
-      v.emplace_back(std::move(memory));
-    }
+  // cull.comp packs the visible instances of each batch at the start of the
+  // batch's range, and writes the batch's draw command
+  const auto visibleInstanceBuffer = device.createBuffer(
+      {{}, sizeof(Instance) * instanceCount,
+       vk::BufferUsageFlagBits::eStorageBuffer |
+           vk::BufferUsageFlagBits::eVertexBuffer,
+       vk::SharingMode::eExclusive, 0, nullptr});
+
+  const auto visibleInstanceMemory = allocator.allocateBuffer(
+      visibleInstanceBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+  const auto drawCommandBuffer = device.createBuffer(
+      {{}, sizeof(vk::DrawIndexedIndirectCommand) * batchCount,
+       vk::BufferUsageFlagBits::eStorageBuffer |
+           vk::BufferUsageFlagBits::eIndirectBuffer,
+       vk::SharingMode::eExclusive, 0, nullptr});
+
+  const auto drawCommandMemory = allocator.allocateBuffer(
+      drawCommandBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+  const auto destroyCullingBuffers = Defer([&] {
+    device.destroyBuffer(visibleInstanceBuffer);
+    allocator.free(visibleInstanceMemory);
+    device.destroyBuffer(drawCommandBuffer);
+    allocator.free(drawCommandMemory);
+  });
 
-    return v;
-  }();
+  vk::DescriptorSetLayout descriptorSetLayout;
+  vk::PipelineLayout pipelineLayout;
+  vk::DescriptorPool descriptorPool;
+  std::vector<vk::DescriptorSet> descriptorSets;
 
-  const auto freeDepthMemories = Defer([&] {
-    for (const auto& memory : depthMemories) {
-      freeMemory(memory);
+  const auto destroyDescriptors = Defer([&] {
+    if (!descriptorSets.empty()) {
+      device.freeDescriptorSets(descriptorPool, descriptorSets);
     }
+    device.destroyDescriptorPool(descriptorPool);
+    device.destroyPipelineLayout(pipelineLayout);
+    device.destroyDescriptorSetLayout(descriptorSetLayout);
   });
 
-  const auto depthImageViews = [&] {
-    std::vector<vk::ImageView> v;
+  // The compute and graphics pipelines share the layout; only the compute
+  // pass binds the set
+  const auto createDescriptors = [&] {
+    const std::array<vk::DescriptorSetLayoutBinding, 4> bindings{
+        {{0, vk::DescriptorType::eUniformBufferDynamic, 1,
+          vk::ShaderStageFlagBits::eCompute, nullptr},
+         {1, vk::DescriptorType::eStorageBuffer, 1,
+          vk::ShaderStageFlagBits::eCompute, nullptr},
+         {2, vk::DescriptorType::eStorageBuffer, 1,
+          vk::ShaderStageFlagBits::eCompute, nullptr},
+         {3, vk::DescriptorType::eStorageBuffer, 1,
+          vk::ShaderStageFlagBits::eCompute, nullptr}}};
+
+    descriptorSetLayout = device.createDescriptorSetLayout(
+        {{}, static_cast<std::uint32_t>(bindings.size()), bindings.data()});
+
+    pipelineLayout =
+        device.createPipelineLayout({{}, 1, &descriptorSetLayout, 0, nullptr});
+
+    const std::array<vk::DescriptorPoolSize, 2> poolSizes{
+        {{vk::DescriptorType::eUniformBufferDynamic, 1},
+         {vk::DescriptorType::eStorageBuffer, 3}}};
+
+    descriptorPool = device.createDescriptorPool(
+        {vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 1,
+         static_cast<std::uint32_t>(poolSizes.size()), poolSizes.data()});
+
+    descriptorSets = device.allocateDescriptorSets(
+        {descriptorPool, 1, &descriptorSetLayout});
+
+    const vk::DescriptorBufferInfo uniformBufferInfo{uniformRing.buffer(), 0,
+                                                     sizeof(ubo)};
+    const vk::DescriptorBufferInfo instanceBufferInfo{instanceBuffer, 0,
+                                                      VK_WHOLE_SIZE};
+    const vk::DescriptorBufferInfo visibleInstanceBufferInfo{
+        visibleInstanceBuffer, 0, VK_WHOLE_SIZE};
+    const vk::DescriptorBufferInfo drawCommandBufferInfo{drawCommandBuffer, 0,
+                                                         VK_WHOLE_SIZE};
+
+    device.updateDescriptorSets(
+        {{descriptorSets.at(0), 0, 0, 1,
+          vk::DescriptorType::eUniformBufferDynamic, nullptr,
+          &uniformBufferInfo, nullptr},
+         {descriptorSets.at(0), 1, 0, 1, vk::DescriptorType::eStorageBuffer,
+          nullptr, &instanceBufferInfo, nullptr},
+         {descriptorSets.at(0), 2, 0, 1, vk::DescriptorType::eStorageBuffer,
+          nullptr, &visibleInstanceBufferInfo, nullptr},
+         {descriptorSets.at(0), 3, 0, 1, vk::DescriptorType::eStorageBuffer,
+          nullptr, &drawCommandBufferInfo, nullptr}},
+        nullptr);
+  };
 
-    for (const auto& image : depthImages) {
-      v.push_back(device.createImageView(
+  // The frame: the instances are advanced and culled in compute passes,
+  // then the visible ones are drawn. The graph derives the barriers between
+  // the passes and the scene's render pass. Depth only lives within the
+  // scene pass, so each frame in flight has a transient depth image.
+  RenderGraph frameGraph(device, allocator);
+
+  const auto instances = frameGraph.importBuffer("instances");
+  const auto visibleInstances = frameGraph.importBuffer("visible_instances");
+  const auto drawCommands = frameGraph.importBuffer("draw_commands");
+  const auto colorTarget =
+      frameGraph.importImage("color", colorFormat, colorFinalLayout);
+  const auto depthTarget = frameGraph.createImage("depth", depthFormat);
+
+  const auto animationPass =
+      frameGraph.addPass("animation", RenderGraph::PassType::eCompute);
+  frameGraph.use(animationPass, instances, RenderGraph::Usage::eComputeWrite);
+
+  const auto cullingPass =
+      frameGraph.addPass("culling", RenderGraph::PassType::eCompute);
+  frameGraph.use(cullingPass, instances, RenderGraph::Usage::eComputeRead);
+  frameGraph.use(cullingPass, visibleInstances,
+                 RenderGraph::Usage::eComputeWrite);
+  frameGraph.use(cullingPass, drawCommands, RenderGraph::Usage::eComputeWrite);
+
+  const auto scenePass =
+      frameGraph.addPass("scene", RenderGraph::PassType::eGraphics,
+                         vk::SubpassContents::eSecondaryCommandBuffers);
+  frameGraph.use(scenePass, drawCommands, RenderGraph::Usage::eIndirectRead);
+  frameGraph.use(scenePass, visibleInstances, RenderGraph::Usage::eVertexRead);
+  frameGraph.use(scenePass, colorTarget, RenderGraph::Usage::eColorAttachment);
+  frameGraph.use(scenePass, depthTarget, RenderGraph::Usage::eDepthAttachment);
+  frameGraph.clear(scenePass, colorTarget, vk::ClearColorValue{});
+  frameGraph.clear(scenePass, depthTarget, vk::ClearDepthStencilValue{1.0f, 0});
+
+  const auto createRenderTargets = [&] {
+    for (const auto& image : colorImages) {
+      colorImageViews.push_back(device.createImageView(
           {{},
            image,
            vk::ImageViewType::e2D,
-           depthFormat,
+           colorFormat,
            {},
-           {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1}}));
-    }
-
-    return v;
-  }();
-
-  const auto destroyDepthImageViews = Defer([&] {
-    for (const auto& imageView : depthImageViews) {
-      device.destroyImageView(imageView);
+           {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}}));
     }
-  });
-
-  UBO ubo{};
-
-  const auto uniformBuffer =
-      device.createBuffer({{},
-                           sizeof(ubo),
-                           vk::BufferUsageFlagBits::eUniformBuffer,
-                           vk::SharingMode::eExclusive,
-                           0,
-                           nullptr});
-
-  const auto destroyUniformBuffer =
-      Defer([&] { device.destroyBuffer(uniformBuffer); });
 
-  const auto uniformMemory = [&] {
-    const auto requirements = device.getBufferMemoryRequirements(uniformBuffer);
-    auto memory = device.allocateMemory(
-        {requirements.size,
-         getMemoryTypeIndex(requirements,
-                            vk::MemoryPropertyFlagBits::eHostVisible |
-                                vk::MemoryPropertyFlagBits::eHostCoherent)});
-
-    auto data = device.mapMemory(memory, 0, requirements.size, {});
-
-    std::memcpy(data, &ubo, sizeof(ubo));
-
-    device.unmapMemory(memory);
-
-    device.bindBufferMemory(uniformBuffer, memory, 0);
-
-    return std::move(memory);
-  }();
-
-  const auto freeUniformMemory = Defer(std::bind(freeMemory, uniformMemory));
-
-  const auto descriptorSetLayout = [&] {
-    const vk::DescriptorSetLayoutBinding binding{
-        0, vk::DescriptorType::eUniformBuffer, 1,
-        vk::ShaderStageFlagBits::eVertex, nullptr};
-
-    return device.createDescriptorSetLayout({{}, 1, &binding});
-  }();
-
-  const auto destroyDescriptorSetLayout =
-      Defer([&] { device.destroyDescriptorSetLayout(descriptorSetLayout); });
-
-  const auto pipelineLayout =
-      device.createPipelineLayout({{}, 1, &descriptorSetLayout, 0, nullptr});
-  const auto destroyPipelineLayout =
-      Defer([&] { device.destroyPipelineLayout(pipelineLayout); });
-
-  const auto descriptorPool = [&] {
-    const vk::DescriptorPoolSize poolSize{vk::DescriptorType::eUniformBuffer,
-                                          1};
-
-    return device.createDescriptorPool(
-        {vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 1, 1,
-         &poolSize});
-  }();
-  const auto destroyDescriptorPool =
-      Defer([&] { device.destroyDescriptorPool(descriptorPool); });
-
-  const auto descriptorSets =
-      device.allocateDescriptorSets({descriptorPool, 1, &descriptorSetLayout});
-  const auto destroyDescriptorSets =
-      Defer([&] { device.freeDescriptorSets(descriptorPool, descriptorSets); });
-
-  const vk::DescriptorBufferInfo uniformBufferInfo{uniformBuffer, 0,
-                                                   sizeof(ubo)};
-
-  device.updateDescriptorSets(
-      {{descriptorSets.at(0), 0, 0, 1, vk::DescriptorType::eUniformBuffer,
-        nullptr, &uniformBufferInfo, nullptr}},
-      nullptr);
-
-  const std::array<vk::AttachmentDescription, 2> attachments{
-      {{{},
-        surfaceFormat.format,
-        vk::SampleCountFlagBits::e1,
-        vk::AttachmentLoadOp::eClear,
-        vk::AttachmentStoreOp::eStore,
-        vk::AttachmentLoadOp::eDontCare,
-        vk::AttachmentStoreOp::eDontCare,
-        vk::ImageLayout::eUndefined,
-        vk::ImageLayout::ePresentSrcKHR},
-       {{},
-        depthFormat,
-        vk::SampleCountFlagBits::e1,
-        vk::AttachmentLoadOp::eClear,
-        vk::AttachmentStoreOp::eDontCare,
-        vk::AttachmentLoadOp::eDontCare,
-        vk::AttachmentStoreOp::eDontCare,
-        vk::ImageLayout::eUndefined,
-        vk::ImageLayout::eDepthStencilAttachmentOptimal}}};
-
-  const vk::AttachmentReference colorReference{
-      0, vk::ImageLayout::eColorAttachmentOptimal};
-
-  const vk::AttachmentReference depthReference{
-      1, vk::ImageLayout::eDepthStencilAttachmentOptimal};
-
-  const vk::SubpassDescription subpass{
-      {},      vk::PipelineBindPoint::eGraphics,
-      0,       nullptr,
-      1,       &colorReference,
-      nullptr, &depthReference,
-      0,       nullptr};
-
-  const auto renderPass =
-      device.createRenderPass({{},
-                               static_cast<std::uint32_t>(attachments.size()),
-                               attachments.data(),
-                               1,
-                               &subpass,
-                               0,
-                               nullptr});
-
-  const auto destroyRenderPass =
-      Defer([&] { device.destroyRenderPass(renderPass); });
-
-  const auto createShaderModule = [&device](const std::string& fileName) {
-    std::ifstream file(fileName, std::ios_base::binary);
-
-    if (file.fail()) {
-      throw std::runtime_error("Can't open file");
-    }
-
-    const std::vector<char> binary{std::istreambuf_iterator<char>(file),
-                                   std::istreambuf_iterator<char>()};
-
-    return device.createShaderModule(
-        {{},
-         static_cast<std::size_t>(binary.size() * sizeof(char)),
-         reinterpret_cast<const std::uint32_t*>(binary.data())});
+    frameGraph.setExtent(renderExtent);
   };
 
-  const auto fragmentShaderModule = createShaderModule("frag.spv");
-  const auto vertexShaderModule = createShaderModule("vert.spv");
+  constexpr const auto& fragmentShader =
+      ShaderRegistry::find(EmbeddedShaders::shaders, "shader.frag");
+  constexpr const auto& vertexShader =
+      ShaderRegistry::find(EmbeddedShaders::shaders, "shader.vert");
+  constexpr const auto& computeShader =
+      ShaderRegistry::find(EmbeddedShaders::shaders, "animate.comp");
+  constexpr const auto& cullShader =
+      ShaderRegistry::find(EmbeddedShaders::shaders, "cull.comp");
+
+  vk::ShaderModule fragmentShaderModule;
+  vk::ShaderModule vertexShaderModule;
+  vk::ShaderModule computeShaderModule;
+  vk::ShaderModule cullShaderModule;
 
   const auto destroyShaderModules = Defer([&] {
     device.destroyShaderModule(fragmentShaderModule);
     device.destroyShaderModule(vertexShaderModule);
+    device.destroyShaderModule(computeShaderModule);
+    device.destroyShaderModule(cullShaderModule);
   });
 
-  const auto framebuffers = [&] {
-    std::vector<vk::Framebuffer> framebuffers;
+  const auto createShaderModules = [&] {
+    fragmentShaderModule =
+        ShaderRegistry::createShaderModule(device, fragmentShader);
+    vertexShaderModule =
+        ShaderRegistry::createShaderModule(device, vertexShader);
+    computeShaderModule =
+        ShaderRegistry::createShaderModule(device, computeShader);
+    cullShaderModule = ShaderRegistry::createShaderModule(device, cullShader);
+  };
 
-    for (int i = 0; i < swapchainImages.size(); i++) {
-      const vk::ImageView attachments[] = {swapchainImageViews.at(i),
-                                           depthImageViews.at(i)};
-      framebuffers.emplace_back(
-          device.createFramebuffer({{},
-                                    renderPass,
-                                    2,
-                                    attachments,
-                                    swapchainExtent.width,
-                                    swapchainExtent.height,
-                                    1}));
-    }
+  const Vertex vertexBufferData[] = {
+      {Snorm16x4::pack(0.0f, -0.5f, 0.0f, 1.0f),
+       Unorm8x4::pack(1.0f, 0.0f, 0.0f, 1.0f)},
+      {Snorm16x4::pack(0.5f, 0.5f, 0.0f, 1.0f),
+       Unorm8x4::pack(0.0f, 1.0f, 0.0f, 1.0f)},
+      {Snorm16x4::pack(-0.5f, 0.5f, 0.0f, 1.0f),
+       Unorm8x4::pack(0.0f, 0.0f, 1.0f, 1.0f)}};
+
+  const std::uint16_t indexBufferData[] = {0, 1, 2};
+
+  // The culling pass tests the mesh's bounding circle, scaled per instance
+  for (const auto& vertex : vertexBufferData) {
+    const auto x = vertex.position.values[0] / 32767.0f;
+    const auto y = vertex.position.values[1] / 32767.0f;
+    ubo.meshRadius = std::max(ubo.meshRadius, std::sqrt(x * x + y * y));
+  }
+  ubo.indexCount = static_cast<std::uint32_t>(
+      sizeof(indexBufferData) / sizeof(indexBufferData[0]));
 
-    return framebuffers;
-  }();
+  Uploader::Buffer vertexBuffer{};
+  Uploader::Buffer indexBuffer{};
 
-  const auto destroyFrameBuffers = Defer([&] {
-    for (const auto& framebuffer : framebuffers) {
-      device.destroyFramebuffer(framebuffer);
+  const auto destroyVertexBuffer = Defer([&] {
+    if (vertexBuffer.buffer) {
+      uploader.destroyBuffer(vertexBuffer);
+    }
+    if (indexBuffer.buffer) {
+      uploader.destroyBuffer(indexBuffer);
     }
   });
 
-  const Vertex vertexBufferData[] = {
-      {{0.0, -0.5, 0.0, 1.0}, {1.0, 0.0, 0.0, 1.0}},
-      {{0.5, 0.5, 0.0, 1.0}, {0.0, 1.0, 0.0, 1.0}},
-      {{-0.5, 0.5, 0.0, 1.0}, {0.0, 0.0, 1.0, 1.0}}};
-
-  const auto vertexBuffer =
-      device.createBuffer({{},
-                           sizeof(vertexBufferData),
-                           vk::BufferUsageFlagBits::eVertexBuffer,
-                           vk::SharingMode::eExclusive,
-                           0,
-                           nullptr});
-
-  const auto destroyVertexBuffer =
-      Defer([&] { device.destroyBuffer(vertexBuffer); });
+  // The first frame waits for the uploads to complete
+  vk::Semaphore uploadSemaphore;
 
-  const auto vertexMemory = [&] {
-    const auto requirements = device.getBufferMemoryRequirements(vertexBuffer);
-    auto memory = device.allocateMemory(
-        vk::MemoryAllocateInfo()
-            .setMemoryTypeIndex(getMemoryTypeIndex(
-                requirements,
-                vk::MemoryPropertyFlagBits::eHostVisible |
-                    vk::MemoryPropertyFlagBits::eHostCoherent))
-            .setAllocationSize(requirements.size));
+  const auto uploadMesh = [&] {
+    vertexBuffer = uploader.createBuffer(
+        sizeof(vertexBufferData), vk::BufferUsageFlagBits::eVertexBuffer);
 
-    auto data = device.mapMemory(memory, 0, requirements.size, {});
+    uploader.upload(vertexBuffer.buffer, 0, vertexBufferData,
+                    sizeof(vertexBufferData));
 
-    std::memcpy(data, &vertexBufferData, sizeof(vertexBufferData));
+    indexBuffer = uploader.createBuffer(sizeof(indexBufferData),
+                                        vk::BufferUsageFlagBits::eIndexBuffer);
 
-    device.unmapMemory(memory);
+    uploader.upload(indexBuffer.buffer, 0, indexBufferData,
+                    sizeof(indexBufferData));
 
-    device.bindBufferMemory(vertexBuffer, memory, 0);
+    uploadSemaphore = uploader.flush();
+  };
 
-    return std::move(memory);
-  }();
+  PipelineCache pipelineCache(device, gpu.getProperties(),
+                              "animation.pipeline_cache");
 
-  const auto freeVertexMemory = Defer(std::bind(freeMemory, vertexMemory));
+  const auto savePipelineCache = Defer([&] {
+    if (!pipelineCache.save()) {
+      Log::print("Failed to save the pipeline cache\n");
+    }
+  });
 
-  const auto graphicsPipeline = [&] {
+  const auto createPipeline = [&] {
     const std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
         {{{},
           vk::ShaderStageFlagBits::eVertex,
@@ -661,16 +846,25 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
           "main",
           nullptr}}};
 
-    const vk::VertexInputBindingDescription vertexBindingDescription{
-        0, sizeof(Vertex), vk::VertexInputRate::eVertex};
-    const std::array<vk::VertexInputAttributeDescription, 2>
-        vertexAttributeDescriptions{
-            {{0, 0, vk::Format::eR32G32B32A32Sfloat, 0},
-             {1, 0, vk::Format::eR32G32B32A32Sfloat, 16}}};
+    const std::array<vk::VertexInputBindingDescription, 2>
+        vertexBindingDescriptions{
+            {{0, sizeof(Vertex), vk::VertexInputRate::eVertex},
+             {1, sizeof(Instance), vk::VertexInputRate::eInstance}}};
+    const auto vertexAttributes = VertexFormat::attributes(
+        0, 0, &Vertex::position, &Vertex::color);
+    const auto instanceAttributes = VertexFormat::attributes(
+        1, 2, &Instance::transform, &Instance::color);
+
+    std::vector<vk::VertexInputAttributeDescription>
+        vertexAttributeDescriptions(vertexAttributes.begin(),
+                                    vertexAttributes.end());
+    vertexAttributeDescriptions.insert(vertexAttributeDescriptions.end(),
+                                       instanceAttributes.begin(),
+                                       instanceAttributes.end());
     const vk::PipelineVertexInputStateCreateInfo vertexInputState{
         {},
-        1,
-        &vertexBindingDescription,
+        static_cast<uint32_t>(vertexBindingDescriptions.size()),
+        vertexBindingDescriptions.data(),
         static_cast<uint32_t>(vertexAttributeDescriptions.size()),
         vertexAttributeDescriptions.data()};
 
@@ -679,11 +873,11 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
 
     const vk::Viewport viewport{0.0f,
                                 0.0f,
-                                static_cast<float>(swapchainExtent.width),
-                                static_cast<float>(swapchainExtent.height),
+                                static_cast<float>(renderExtent.width),
+                                static_cast<float>(renderExtent.height),
                                 0.0f,
                                 1.0f};
-    const vk::Rect2D scissor{{0, 0}, swapchainExtent};
+    const vk::Rect2D scissor{{0, 0}, renderExtent};
     const vk::PipelineViewportStateCreateInfo viewportState{
         {}, 1, &viewport, 1, &scissor};
 
@@ -722,7 +916,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
     const vk::PipelineColorBlendStateCreateInfo colorBlendState{
         {}, VK_FALSE, vk::LogicOp::eNoOp, 1, &attachment, {1.0f}};
 
-    return device.createGraphicsPipeline(nullptr,
+    return device.createGraphicsPipeline(pipelineCache.handle(),
                                          {{},
                                           static_cast<uint32_t>(stages.size()),
                                           stages.data(),
@@ -736,87 +930,632 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
                                           &colorBlendState,
                                           nullptr,
                                           pipelineLayout,
-                                          renderPass,
+                                          frameGraph.renderPass(scenePass),
                                           0,
                                           nullptr,
                                           0});
-  }();
+  };
+
+  vk::Pipeline graphicsPipeline;
 
   const auto destroyPipeline =
       Defer([&] { device.destroyPipeline(graphicsPipeline); });
 
-  for (int i = 0; i < commandBuffers.size(); i++) {
-    const auto& commandBuffer = commandBuffers.at(i);
-    const std::array<vk::ClearValue, 2> clearValues = {
-        vk::ClearColorValue{}, vk::ClearDepthStencilValue{1.0f, 0}};
+  vk::Pipeline computePipeline;
+  vk::Pipeline cullPipeline;
 
-    vk::CommandBufferBeginInfo beginInfo{{}, nullptr};
-    commandBuffer.begin(beginInfo);
+  const auto destroyComputePipelines = Defer([&] {
+    device.destroyPipeline(computePipeline);
+    device.destroyPipeline(cullPipeline);
+  });
+
+  const auto createComputePipeline =
+      [&](const vk::ShaderModule& module,
+          const vk::SpecializationInfo* specialization = nullptr) {
+        return device.createComputePipeline(
+            pipelineCache.handle(),
+            {{},
+             {{},
+              vk::ShaderStageFlagBits::eCompute,
+              module,
+              "main",
+              specialization},
+             pipelineLayout,
+             {},
+             0});
+      };
+
+  // cull.comp leaves firstInstance at 0 when each batch is bound at its own
+  // offset
+  const VkBool32 bindBatches = cpuCulling ? VK_TRUE : VK_FALSE;
+  const vk::SpecializationMapEntry bindBatchesEntry{0, 0, sizeof(VkBool32)};
+  const vk::SpecializationInfo cullSpecialization{1, &bindBatchesEntry,
+                                                  sizeof(bindBatches),
+                                                  &bindBatches};
+
+  // Independent startup work runs on worker threads as soon as what it
+  // depends on is ready. Every object above is created by one of these tasks.
+  {
+    TaskGraph startup;
+
+    const auto colorImagesTask = startup.add("color_images", createColorImages);
+    const auto renderPassTask = startup.add(
+        "render_pass", [&] { frameGraph.compile(framesInFlight); });
+    startup.add("render_targets", createRenderTargets,
+                {colorImagesTask, renderPassTask});
+    startup.add("command_buffers", createCommandBuffers);
+    const auto descriptorsTask = startup.add("descriptors", createDescriptors);
+    const auto shaderModulesTask =
+        startup.add("shader_modules", createShaderModules);
+    startup.add("mesh_upload", uploadMesh);
+    startup.add("pipeline",
+                [&] {
+                  graphicsPipeline = createPipeline();
+                  Log::print("Pipeline created with a %s cache\n",
+                             pipelineCache.warm() ? "warm" : "cold");
+                },
+                {renderPassTask, descriptorsTask, shaderModulesTask});
+    startup.add("compute_pipeline",
+                [&] {
+                  computePipeline = createComputePipeline(computeShaderModule);
+                },
+                {descriptorsTask, shaderModulesTask});
+    startup.add("cull_pipeline",
+                [&] {
+                  cullPipeline = createComputePipeline(cullShaderModule,
+                                                       &cullSpecialization);
+                },
+                {descriptorsTask, shaderModulesTask});
+
+    startup.run();
+    startup.printTimeline("Startup");
+  }
+
+  // What the depth images take, and what they would at 4K with triple
+  // buffering compared to one per swapchain image
+  {
+    const double mebibyte = 1024.0 * 1024.0;
+    const auto& report = frameGraph.memoryReport();
+
+    Log::print("Depth: %u images, %.1f MiB allocated, %.1f MiB lazily\n",
+               report.attachmentCount, report.allocatedBytes / mebibyte,
+               report.lazyBytes / mebibyte);
+
+    const vk::Extent2D extent4k{3840, 2160};
+    const std::uint32_t swapchainImageCount = 3;
+    const auto requirements = TransientAttachmentPool::requirements(
+        device, depthFormat, extent4k,
+        vk::ImageUsageFlagBits::eDepthStencilAttachment);
+    const auto lazy = TransientAttachmentPool::hasLazyMemory(
+        allocator.memoryProperties(), requirements.memoryTypeBits);
+
+    Log::print(
+        "Depth at %ux%u: %.1f MiB per swapchain image (%u), %.1f MiB per "
+        "frame in flight (%u)%s\n",
+        extent4k.width, extent4k.height,
+        requirements.size * swapchainImageCount / mebibyte,
+        swapchainImageCount, requirements.size * framesInFlight / mebibyte,
+        framesInFlight, lazy ? ", lazily allocated" : "");
+  }
+
+  // GPU time and pipeline statistics of each frame's render pass
+  GpuProfiler profiler(device, gpu, graphicsQueueFamilyIndex, framesInFlight);
+
+  RecordingScheduler scheduler(device, graphicsQueueFamilyIndex,
+                               framesInFlight, threadCount);
+
+  // Their bounds are in the grid's frame, where they don't move
+  FrustumCuller culler(threadCount);
+  BoundingSpheres batchBounds;
+
+  if (cpuCulling) {
+    // Laid out as in animate.comp, at the largest scale the instances pulse
+    // to
+    const auto gridSize = static_cast<std::uint32_t>(
+        std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+    const auto cellSize = 2.0f / gridSize;
+    const auto instanceRadius = ubo.meshRadius * cellSize * 0.5f;
+
+    const auto cellCenter = [&](std::uint32_t index) {
+      return -1.0f + cellSize * (index + 0.5f);
+    };
+
+    batchBounds.resize(batchCount);
+
+    for (std::uint32_t batch = 0; batch < batchCount; batch++) {
+      const auto first = batch * computeGroupSize;
+      const auto last = std::min(first + computeGroupSize, instanceCount) - 1;
+
+      // Whole rows, unless the batch is within a single row
+      const auto firstRow = first / gridSize;
+      const auto lastRow = last / gridSize;
+      const bool singleRow = firstRow == lastRow;
+      const auto minX = cellCenter(singleRow ? first % gridSize : 0);
+      const auto maxX =
+          cellCenter(singleRow ? last % gridSize : gridSize - 1);
+      const auto minY = cellCenter(firstRow);
+      const auto maxY = cellCenter(lastRow);
+
+      const auto halfWidth = (maxX - minX) * 0.5f;
+      const auto halfHeight = (maxY - minY) * 0.5f;
+
+      batchBounds.set(
+          batch, minX + halfWidth, minY + halfHeight, 0.0f,
+          std::sqrt(halfWidth * halfWidth + halfHeight * halfHeight) +
+              instanceRadius);
+    }
+
+    Log::print("Culling batches on the CPU with the %s kernel\n",
+               FrustumCuller::kernel());
+  }
+
+  // Returns the batches that may be visible this frame. The frustum is moved
+  // into the grid's frame instead of moving the bounds.
+  const auto cullBatches = [&]() -> const std::vector<std::uint32_t>& {
+    Frustum frustum;
 
-    commandBuffer.beginRenderPass({renderPass,
-                                  framebuffers.at(i),
-                                  {{0, 0}, swapchainExtent},
-                                  static_cast<std::uint32_t>(clearValues.size()),
-                                  clearValues.data()},
-                                  vk::SubpassContents::eInline);
+    for (std::size_t i = 0; i < frustum.size(); i++) {
+      const auto& plane = ubo.frustumPlanes[i];
+      frustum[i] = {plane.x, plane.y, plane.z,
+                    plane.w + plane.x * ubo.gridOffset.x +
+                        plane.y * ubo.gridOffset.y};
+    }
+
+    return culler.cull(batchBounds, frustum);
+  };
 
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-                              graphicsPipeline);
-    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                    pipelineLayout, 0, descriptorSets, nullptr);
-    commandBuffer.bindVertexBuffers(0, {vertexBuffer}, {0});
-    commandBuffer.draw(3, 1, 0, 0);
+  // Dynamic offset of the uniform data of the frame being recorded
+  std::uint32_t frameUniformOffset = 0;
+
+  // Advances the instances
+  frameGraph.setRecord(
+      animationPass, [&](const RenderGraph::PassContext& context) {
+        const auto& commandBuffer = context.commandBuffer;
+        const auto region = profiler.beginRegion(commandBuffer, "animation");
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                   computePipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                         pipelineLayout, 0, descriptorSets,
+                                         frameUniformOffset);
+        commandBuffer.dispatch(batchCount, 1, 1);
+
+        profiler.endRegion(commandBuffer, region);
+      });
+
+  // Packs the visible instances and writes the draw commands, with the
+  // descriptor sets the animation pass bound
+  frameGraph.setRecord(
+      cullingPass, [&](const RenderGraph::PassContext& context) {
+        const auto& commandBuffer = context.commandBuffer;
+        const auto region = profiler.beginRegion(commandBuffer, "culling");
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                   cullPipeline);
+        commandBuffer.dispatch(batchCount, 1, 1);
+
+        profiler.endRegion(commandBuffer, region);
+      });
+
+  // The profiled region covers the whole render pass, clears and stores
+  // included. Queries can't be written inside it, as it only executes
+  // secondary command buffers.
+  std::uint32_t renderPassRegion = 0;
+
+  frameGraph.setAround(
+      scenePass,
+      [&](const RenderGraph::PassContext& context) {
+        renderPassRegion =
+            profiler.beginRegion(context.commandBuffer, "render_pass");
+      },
+      [&](const RenderGraph::PassContext& context) {
+        profiler.endRegion(context.commandBuffer, renderPassRegion);
+      });
+
+  // Each thread draws a range of the batches. What they draw is up to the
+  // culling pass, so the recorded commands don't change with the view,
+  // unless the CPU culls batches too.
+  frameGraph.setRecord(
+      scenePass, [&](const RenderGraph::PassContext& context) {
+        const auto& commandBuffer = context.commandBuffer;
+
+        const vk::CommandBufferInheritanceInfo inheritance{
+            context.renderPass, 0, context.framebuffer, VK_FALSE, {},
+            profiler.inheritedStatistics()};
+
+        const auto visibleBatches = cpuCulling ? &cullBatches() : nullptr;
+        const auto drawCount =
+            visibleBatches != nullptr
+                ? static_cast<std::uint32_t>(visibleBatches->size())
+                : batchCount;
+
+        scheduler.beginFrame(context.frameIndex);
+        const auto& secondaryCommandBuffers = scheduler.record(
+            inheritance, drawCount,
+            [&](const vk::CommandBuffer& secondary, std::uint32_t first,
+                std::uint32_t count) {
+              const std::uint32_t stride =
+                  sizeof(vk::DrawIndexedIndirectCommand);
+
+              secondary.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                     graphicsPipeline);
+              secondary.bindVertexBuffers(
+                  0, {vertexBuffer.buffer, visibleInstanceBuffer}, {0, 0});
+              secondary.bindIndexBuffer(indexBuffer.buffer, 0,
+                                        vk::IndexType::eUint16);
+
+              if (visibleBatches != nullptr) {
+                for (auto i = first; i < first + count; i++) {
+                  const auto batch = visibleBatches->at(i);
+
+                  secondary.bindVertexBuffers(
+                      1, {visibleInstanceBuffer},
+                      {static_cast<vk::DeviceSize>(batch) * computeGroupSize *
+                       sizeof(Instance)});
+                  secondary.drawIndexedIndirect(drawCommandBuffer,
+                                                batch * stride, 1, stride);
+                }
+                return;
+              }
+
+              for (auto batch = first; batch < first + count;
+                   batch += maxDrawIndirectCount) {
+                secondary.drawIndexedIndirect(
+                    drawCommandBuffer, batch * stride,
+                    std::min(maxDrawIndirectCount, first + count - batch),
+                    stride);
+              }
+            });
+
+        // Nothing is recorded when every batch was culled, and executing no
+        // command buffers isn't allowed
+        if (!secondaryCommandBuffers.empty()) {
+          commandBuffer.executeCommands(secondaryCommandBuffers);
+        }
+      });
+
+  const auto recordCommandBuffer = [&](std::uint32_t frameIndex,
+                                       std::uint32_t imageIndex,
+                                       std::uint32_t uniformOffset) {
+    const auto& commandBuffer = commandBuffers.at(frameIndex);
+
+    vk::CommandBufferBeginInfo beginInfo{
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr};
+    commandBuffer.begin(beginInfo);
 
-    commandBuffer.endRenderPass();
+    profiler.beginFrame(commandBuffer, frameIndex);
+
+    frameUniformOffset = uniformOffset;
+    frameGraph.setImage(colorTarget, colorImages.at(imageIndex),
+                        colorImageViews.at(imageIndex));
+    frameGraph.execute(commandBuffer, frameIndex);
 
     commandBuffer.end();
+  };
+
+  // Steps per second of the simulation, whatever the frame rate
+  const double simulationRate = 120.0;
+
+  FixedStepSimulation<SimulationState> simulation(
+      {0.0f, glm::vec2(0.0f)}, simulationRate,
+      [](SimulationState& state, double step) {
+        state.time += static_cast<float>(step);
+
+        // The grid sways from side to side, so that the columns at its
+        // edges leave the screen
+        state.gridOffset =
+            glm::vec2(0.5f * std::sin(state.time * 0.5f), 0.0f);
+      });
+
+  // When the latest simulation step the frame being recorded shows was due
+  FixedStepSimulation<SimulationState>::Clock::time_point frameSimulationTime;
+
+  // Returns the dynamic offset of this frame's uniform data, which is all
+  // the CPU writes for the animation. The simulation is interpolated
+  // between its last two steps, so it moves smoothly at any frame rate.
+  const auto updateBuffer = [&](std::uint32_t frameIndex) {
+    const auto sample = simulation.sample();
+    frameSimulationTime = sample.due;
+    const auto alpha = static_cast<float>(sample.alpha);
+    const auto time = sample.previous.time +
+                      (sample.current.time - sample.previous.time) * alpha;
+
+    // The GPU accumulates rotation, so time must not run backwards
+    ubo.deltaTime = std::max(time - ubo.time, 0.0f);
+    ubo.time = std::max(time, ubo.time);
+    ubo.gridOffset =
+        sample.previous.gridOffset +
+        (sample.current.gridOffset - sample.previous.gridOffset) * alpha;
+
+    uniformRing.beginFrame(frameIndex);
+    const auto offset = uniformRing.push(ubo);
+
+    // Only the first frame lays the instances out
+    ubo.reset = 0;
+
+    return offset;
+  };
+
+  const vk::PipelineStageFlags uploadWaitDstStageMask =
+      vk::PipelineStageFlagBits::eVertexInput;
+
+  // Created signaled so that the first use of each frame doesn't block
+  const auto drawFences = [&] {
+    std::vector<vk::Fence> v(framesInFlight);
+
+    std::generate(v.begin(), v.end(), [&] {
+      return device.createFence({vk::FenceCreateFlagBits::eSignaled});
+    });
+
+    return v;
+  }();
+
+  const auto destroyDrawFences = Defer([&] {
+    for (const auto& fence : drawFences) {
+      device.destroyFence(fence);
+    }
+  });
+
+  // Waits until the GPU has finished the frame last submitted from the given
+  // slot and returns how long the CPU was blocked
+  const auto waitForFrame = [&](std::uint32_t frameIndex) {
+    const auto& fence = drawFences.at(frameIndex);
+
+    const auto waitBegin = std::chrono::steady_clock::now();
+    device.waitForFences({fence}, VK_TRUE, UINT64_MAX);
+    const std::chrono::duration<double, std::milli> waitTime =
+        std::chrono::steady_clock::now() - waitBegin;
+
+    return waitTime.count();
+  };
+
+  // Collects the profile of the frame last submitted from the given slot,
+  // which must have completed, and returns its GPU time
+  const auto collectGpuTime = [&](std::uint32_t frameIndex) {
+    const auto profile = profiler.collect(frameIndex);
+
+    return profile != nullptr ? profile->gpuMs() : 0.0;
+  };
+
+  // Exports the collected profiles into the working directory
+  const auto saveProfile = [&] {
+    if (auto file = std::fopen("animation_gpu_profile.csv", "w")) {
+      profiler.writeCsv(file);
+      std::fclose(file);
+    }
+
+    if (auto file = std::fopen("animation_gpu_profile.json", "w")) {
+      profiler.writeJson(file);
+      std::fclose(file);
+    }
+  };
+
+  // Logs the time from the start of main() to the first submitted frame,
+  // which parallel startup is meant to shorten
+  bool firstFrameLogged = false;
+  const auto logTimeToFirstFrame = [&] {
+    if (firstFrameLogged) {
+      return;
+    }
+
+    firstFrameLogged = true;
+
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - startupBegin;
+    Log::print("Time to first frame: %.3f ms\n", elapsed.count());
+  };
+
+#if defined(HEADLESS)
+  FrameStats stats;
+
+  // Timings of the frame last submitted from each slot. They are reported
+  // once the slot comes around again and its GPU time is known.
+  std::vector<FrameStats::Frame> pendingFrames(framesInFlight);
+
+  const auto runBegin = std::chrono::steady_clock::now();
+
+  std::uint32_t frame = 0;
+
+  platform.run([&] {
+    if (frame == frameCount) {
+      return false;
+    }
+
+    const auto frameIndex = frame % framesInFlight;
+    auto& pending = pendingFrames.at(frameIndex);
+
+    const auto fenceWaitTime = waitForFrame(frameIndex);
+
+    if (frame >= framesInFlight) {
+      pending.gpuMs = collectGpuTime(frameIndex);
+      stats.add(pending);
+    }
+
+    const auto cpuBegin = std::chrono::steady_clock::now();
+
+    device.resetFences({drawFences.at(frameIndex)});
+    device.resetCommandPool(commandPools.at(frameIndex), {});
+
+    const auto uniformOffset = updateBuffer(frameIndex);
+    recordCommandBuffer(frameIndex, frameIndex, uniformOffset);
+
+    const std::uint32_t waitCount = uploadSemaphore ? 1 : 0;
+    graphicsQueue.submit({{waitCount, &uploadSemaphore, &uploadWaitDstStageMask,
+                           1, &commandBuffers.at(frameIndex), 0, nullptr}},
+                         drawFences.at(frameIndex));
+    uploadSemaphore = vk::Semaphore{};
+
+    const std::chrono::duration<double, std::milli> cpuTime =
+        std::chrono::steady_clock::now() - cpuBegin;
+
+    pending = {cpuTime.count(), 0.0, fenceWaitTime};
+
+    logTimeToFirstFrame();
+
+    return ++frame < frameCount;
+  });
+
+  // Drain the frames still in flight in submission order
+  for (frame = frameCount > framesInFlight ? frameCount - framesInFlight : 0;
+       frame < frameCount; frame++) {
+    const auto frameIndex = frame % framesInFlight;
+    auto& pending = pendingFrames.at(frameIndex);
+
+    waitForFrame(frameIndex);
+
+    pending.gpuMs = collectGpuTime(frameIndex);
+    stats.add(pending);
   }
 
-  const auto updateBuffer = [&] {
-    // I know getting requirements every frame is very insufficient!
-    const auto requirements = device.getBufferMemoryRequirements(uniformBuffer);
-    const auto memory = uniformMemory;
+  const std::chrono::duration<double, std::milli> runTime =
+      std::chrono::steady_clock::now() - runBegin;
+  stats.setElapsed(runTime.count());
 
-    ubo.scale += 0.1f;
+  stats.print(stdout);
+  allocator.printStats(stdout);
+  saveProfile();
 
-    auto data = device.mapMemory(memory, 0, requirements.size, {});
-    std::memcpy(data, &ubo, sizeof(ubo));
-    device.unmapMemory(memory);
+  return 0;
+#else
+  const auto createSemaphores = [&] {
+    std::vector<vk::Semaphore> v(framesInFlight);
+
+    std::generate(v.begin(), v.end(),
+                  [&] { return device.createSemaphore({}); });
+
+    return v;
   };
 
-  const auto imageAcquiredSemaphore = device.createSemaphore({});
-  const auto destroyImageAcquiredSemaphore =
-      Defer([&] { device.destroySemaphore(imageAcquiredSemaphore); });
+  const auto imageAcquiredSemaphores = createSemaphores();
+  const auto drawCompletedSemaphores = createSemaphores();
 
-  const auto drawCompletedSemaphore = device.createSemaphore({});
-  const auto destroyDrawCompletedSemaphore =
-      Defer([&] { device.destroySemaphore(drawCompletedSemaphore); });
+  const auto destroySemaphores = Defer([&] {
+    for (const auto& semaphore : imageAcquiredSemaphores) {
+      device.destroySemaphore(semaphore);
+    }
+    for (const auto& semaphore : drawCompletedSemaphores) {
+      device.destroySemaphore(semaphore);
+    }
+  });
 
+  std::uint32_t frameIndex = 0;
   std::uint32_t currentImageIndex;
 
-  const auto drawFence = device.createFence({vk::FenceCreateFlags{}});
-  const auto destroyDrawFence = Defer([&] { device.destroyFence(drawFence); });
+  // Time the CPU spent blocked on fences, shown in the window title
+  auto reportBegin = std::chrono::steady_clock::now();
+  std::uint32_t reportFrameCount = 0;
+  double reportFenceWaitTime = 0.0;
+  double reportGpuTime = 0.0;
+  std::size_t reportLatencyBegin = 0;
+
+  // Stages of the frame last submitted from each slot, added to the latency
+  // stats once its fence is seen signaled
+  LatencyStats latency;
+  std::vector<LatencyStats::Frame> pendingLatencies(framesInFlight);
+  std::vector<bool> latencyPending(framesInFlight, false);
+
+  // Completes the frames whose fence has signaled, oldest first
+  const auto pollCompletedFrames = [&] {
+    const auto now = LatencyStats::Clock::now();
+
+    for (std::uint32_t i = 0; i < framesInFlight; i++) {
+      const auto slot = (frameIndex + i) % framesInFlight;
+
+      if (latencyPending.at(slot) &&
+          device.getFenceStatus(drawFences.at(slot)) == vk::Result::eSuccess) {
+        pendingLatencies.at(slot).complete = now;
+        latency.add(pendingLatencies.at(slot));
+        latencyPending.at(slot) = false;
+      }
+    }
+  };
 
   const auto draw = [&] {
-    device.waitForFences({drawFence}, VK_FALSE, 1'000'000'000);
-    device.resetFences({drawFence});
+    pollCompletedFrames();
+    reportFenceWaitTime += waitForFrame(frameIndex);
+    pollCompletedFrames();
+    reportGpuTime += collectGpuTime(frameIndex);
+    device.resetFences({drawFences.at(frameIndex)});
+    device.resetCommandPool(commandPools.at(frameIndex), {});
+
+    const auto& imageAcquiredSemaphore = imageAcquiredSemaphores.at(frameIndex);
+    const auto& drawCompletedSemaphore = drawCompletedSemaphores.at(frameIndex);
 
     device.acquireNextImageKHR(swapchain, UINT64_MAX, imageAcquiredSemaphore, {},
                               &currentImageIndex);
 
-    const auto& commandBuffer = commandBuffers.at(currentImageIndex);
+    const auto uniformOffset = updateBuffer(frameIndex);
+
+    auto& pendingLatency = pendingLatencies.at(frameIndex);
+    pendingLatency.simulation = frameSimulationTime;
+    recordCommandBuffer(frameIndex, currentImageIndex, uniformOffset);
+
+    const auto& commandBuffer = commandBuffers.at(frameIndex);
+
+    const std::array<vk::Semaphore, 2> waitSemaphores = {
+        imageAcquiredSemaphore, uploadSemaphore};
+    const std::array<vk::PipelineStageFlags, 2> waitDstStageMasks = {
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        uploadWaitDstStageMask};
+    const std::uint32_t waitCount = uploadSemaphore ? 2 : 1;
+    graphicsQueue.submit({{waitCount, waitSemaphores.data(),
+                          waitDstStageMasks.data(), 1, &commandBuffer, 1,
+                          &drawCompletedSemaphore}},
+                        drawFences.at(frameIndex));
+    uploadSemaphore = vk::Semaphore{};
+    pendingLatency.submit = LatencyStats::Clock::now();
 
-    const vk::PipelineStageFlags waitDstStageMask =
-        vk::PipelineStageFlagBits::eColorAttachmentOutput;
-    graphicsQueue.submit({{1, &imageAcquiredSemaphore, &waitDstStageMask, 1,
-                          &commandBuffer, 0, &drawCompletedSemaphore}},
-                        drawFence);
+    presentQueue.presentKHR(
+        {1, &drawCompletedSemaphore, 1, &swapchain, &currentImageIndex});
+    pendingLatency.present = LatencyStats::Clock::now();
+    latencyPending.at(frameIndex) = true;
 
-    presentQueue.presentKHR({0, &drawCompletedSemaphore, 1, &swapchain, &currentImageIndex});
+    logTimeToFirstFrame();
+
+    frameIndex = (frameIndex + 1) % framesInFlight;
   };
 
-  WindowsHelper::mainLoop([&]{
-    updateBuffer();
+  const auto report = [&] {
+    reportFrameCount++;
+
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - reportBegin;
+
+    if (elapsed.count() < 1000.0) {
+      return;
+    }
+
+    platform.setTitle(
+        "vulkan-playground - " +
+        std::to_string(reportFrameCount * 1000.0 / elapsed.count()) +
+        " fps, " + std::to_string(reportGpuTime / reportFrameCount) +
+        " ms/frame on the GPU, " +
+        std::to_string(reportFenceWaitTime / reportFrameCount) +
+        " ms/frame blocked on fences, " +
+        std::to_string(latency.meanCompleteMs(reportLatencyBegin)) +
+        " ms from simulation to GPU completion");
+
+    reportBegin = std::chrono::steady_clock::now();
+    reportFrameCount = 0;
+    reportFenceWaitTime = 0.0;
+    reportGpuTime = 0.0;
+    reportLatencyBegin = latency.size();
+  };
+
+  platform.run([&] {
     draw();
+    report();
+
+    return true;
   });
+
+  device.waitIdle();
+  pollCompletedFrames();
+  saveProfile();
+
+  if (auto file = std::fopen("animation_latency.csv", "w")) {
+    latency.print(file);
+    std::fclose(file);
+  }
+#endif
 }
@@ -6,9 +6,10 @@
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec4 inColor;
 
-layout (binding = 0) uniform UBO {
-  float scale;
-} ubo;
+// Per instance, animated by animate.comp: offset in xy, scale in z and
+// rotation in radians in w
+layout (location = 2) in vec4 inInstanceTransform;
+layout (location = 3) in vec4 inInstanceColor;
 
 layout(location = 0) out vec4 outColor;
 
@@ -17,6 +18,12 @@ out gl_PerVertex {
 };
 
 void main() {
-  gl_Position = vec4(inPosition * ubo.scale, 1.0);
-  outColor = inColor;
+  const float s = sin(inInstanceTransform.w);
+  const float c = cos(inInstanceTransform.w);
+  const vec2 p = inPosition.xy * inInstanceTransform.z;
+
+  gl_Position = vec4(vec2(c * p.x - s * p.y, s * p.x + c * p.y) +
+                         inInstanceTransform.xy,
+                     inPosition.z, 1.0);
+  outColor = inColor * inInstanceColor;
 }
@@ -1,23 +1,29 @@
-#define NOMINMAX
-#include <windows.h>
-
 #include <vulkan/vulkan.hpp>
 
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <fstream>
 #include <functional>
-#include <iterator>
 #include <string>
 #include <vector>
 
 #include "glm/mat4x4.hpp"
-#include "glm/vec4.hpp"
 
 #include "Defer.hpp"
-#include "WindowsHelper.hpp"
+#include "DeletionQueue.hpp"
+#include "EmbeddedShaders.hpp"
+#include "Log.hpp"
+#include "MemoryAllocator.hpp"
+#include "PipelineCache.hpp"
+#include "Platform.hpp"
+#include "RenderGraph.hpp"
+#include "TaskGraph.hpp"
+#include "TransformHierarchy.hpp"
+#include "Uploader.hpp"
+#include "VertexFormat.hpp"
 
 struct UBO {
     glm::mat4 model;
@@ -25,18 +31,29 @@ struct UBO {
     glm::mat4 projection;
 };
 
+// 12 bytes instead of two vec4s
 struct Vertex {
-    glm::vec4 position;
-    glm::vec4 color;
+    Snorm16x4 position;
+    Unorm8x4 color;
 };
 
-int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
+int main()
 {
+    const auto startupBegin = std::chrono::steady_clock::now();
+
+    // The triangle never changes, so only wake up for window events such as
+    // resizes
+    Platform platform([] {
+        PlatformConfig config;
+        config.loopMode = LoopMode::eOnDemand;
+        config.resizable = true;
+        return config;
+    }());
+
     // Create an vulkan instance
     const auto instance = [] {
         const auto extensions = [] {
-            std::vector<const char*> wanted = { VK_KHR_SURFACE_EXTENSION_NAME,
-                VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+            auto wanted = Platform::instanceExtensions();
 
             const auto props = vk::enumerateInstanceExtensionProperties();
 
@@ -83,13 +100,8 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
 
     const auto destroyInstance = Defer([&] { instance.destroy(); });
 
-    // Create a window
-    const auto hWnd = WindowsHelper::createWindow(hInstance);
-    ShowWindow(hWnd, SW_SHOWDEFAULT);
-
     // Create a surface
-    const auto surface
-        = instance.createWin32SurfaceKHR({ {}, hInstance, hWnd });
+    const auto surface = platform.createSurface(instance);
 
     const auto destroySurface
         = Defer([&] { instance.destroySurfaceKHR(surface); });
@@ -123,6 +135,25 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
         return static_cast<std::uint32_t>(i);
     }();
 
+    // Uploads go through a transfer-only queue family when there is one,
+    // which usually maps to a dedicated copy engine
+    const auto transferQueueFamilyIndex = [&] {
+        const auto i = std::distance(queueFamilyProperties.cbegin(),
+            std::find_if(queueFamilyProperties.cbegin(),
+                queueFamilyProperties.cend(), [](const auto& prop) {
+                    return (prop.queueFlags & vk::QueueFlagBits::eTransfer)
+                        && !(prop.queueFlags
+                               & (vk::QueueFlagBits::eGraphics
+                                     | vk::QueueFlagBits::eCompute));
+                }));
+
+        if (i == queueFamilyProperties.size()) {
+            return graphicsQueueFamilyIndex;
+        }
+
+        return static_cast<std::uint32_t>(i);
+    }();
+
     const auto presentQueueFamilyIndex = [&] {
         std::vector<vk::Bool32> supportPresent;
 
@@ -153,12 +184,21 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
         std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos{ { {},
             graphicsQueueFamilyIndex, 1, &graphicsQueuePriority } };
 
+        const float presentQueuePriority = 0.0f;
         if (separatePresentQueue) {
-            const float presentQueuePriority = 0.0f;
             queueCreateInfos.emplace_back(vk::DeviceQueueCreateFlags{},
                 presentQueueFamilyIndex, 1, &presentQueuePriority);
         }
 
+        const float transferQueuePriority = 0.0f;
+        if (std::none_of(queueCreateInfos.cbegin(), queueCreateInfos.cend(),
+                [&](const auto& info) {
+                    return info.queueFamilyIndex == transferQueueFamilyIndex;
+                })) {
+            queueCreateInfos.emplace_back(vk::DeviceQueueCreateFlags{},
+                transferQueueFamilyIndex, 1, &transferQueuePriority);
+        }
+
         const auto extensions = [&] {
             std::vector<const char*> wanted
                 = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
@@ -211,6 +251,18 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
 
     const auto graphicsQueue = device.getQueue(graphicsQueueFamilyIndex, 0);
     const auto presentQueue = device.getQueue(presentQueueFamilyIndex, 0);
+    const auto transferQueue = device.getQueue(transferQueueFamilyIndex, 0);
+
+    // Resources are sub-allocated from a few large memory blocks
+    MemoryAllocator allocator(device, gpu);
+
+    // Objects replaced while a frame may still use them, e.g. on resize, are
+    // destroyed once that frame has completed
+    DeletionQueue deletionQueue(device, allocator);
+
+    // Device-local buffers are filled through a staging ring
+    Uploader uploader(device, allocator, transferQueue,
+        transferQueueFamilyIndex, graphicsQueueFamilyIndex);
 
     // Pick a surface format
     const auto& surfaceFormat = [&] {
@@ -228,29 +280,81 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
         return *format;
     }();
 
-    const auto surfaceCapabilities = gpu.getSurfaceCapabilitiesKHR(surface);
+    const auto depthFormat = vk::Format::eD32Sfloat;
 
-    const auto swapchainExtent = [&] {
-        if (surfaceCapabilities.currentExtent.width == -1) {
-            const auto windowSize = WindowsHelper::getWindowSize(hWnd);
+    // The frame is a single pass drawing into the swapchain image, with a
+    // depth image the graph creates. The graph derives its render pass.
+    RenderGraph frameGraph(device, allocator, &deletionQueue);
+
+    const auto colorTarget = frameGraph.importImage(
+        "color", surfaceFormat.format, vk::ImageLayout::ePresentSrcKHR);
+    const auto depthTarget = frameGraph.createImage("depth", depthFormat);
+
+    const auto scenePass
+        = frameGraph.addPass("scene", RenderGraph::PassType::eGraphics);
+    frameGraph.use(
+        scenePass, colorTarget, RenderGraph::Usage::eColorAttachment);
+    frameGraph.use(
+        scenePass, depthTarget, RenderGraph::Usage::eDepthAttachment);
+    frameGraph.clear(scenePass, colorTarget, vk::ClearColorValue{});
+    frameGraph.clear(
+        scenePass, depthTarget, vk::ClearDepthStencilValue{ 1.0f, 0 });
+
+    // A frame is done before the next one starts
+    const auto createRenderPass = [&] { frameGraph.compile(1); };
+
+    // Everything that depends on the swapchain images or their extent. It is
+    // rebuilt when the window is resized or the swapchain goes out of date.
+    // The pipeline sets the viewport and the scissor dynamically, so it
+    // survives.
+    Retiring<vk::SwapchainKHR> swapchain;
+    vk::Extent2D swapchainExtent{ 0, 0 };
+    std::vector<vk::Image> swapchainImages;
+    std::vector<Retiring<vk::ImageView>> swapchainImageViews;
+
+    // Creates the swapchain, replacing the current one if any, and returns
+    // false when the surface has no area to present to. The current
+    // swapchain and its targets are retired, not waited for.
+    const auto createSwapchain = [&] {
+        const auto surfaceCapabilities
+            = gpu.getSurfaceCapabilitiesKHR(surface);
+
+        const auto extent = [&] {
+            if (surfaceCapabilities.currentExtent.width == -1) {
+                const auto wanted = platform.extent();
+
+                const auto& minExtent = surfaceCapabilities.minImageExtent;
+                const auto& maxExtent = surfaceCapabilities.maxImageExtent;
+
+                return vk::Extent2D{
+                    std::min(std::max(wanted.width, minExtent.width),
+                        maxExtent.width),
+                    std::min(std::max(wanted.height, minExtent.height),
+                        maxExtent.height) };
+            }
+
+            return surfaceCapabilities.currentExtent;
+        }();
 
-            return vk::Extent2D{ static_cast<std::uint32_t>(windowSize.cx),
-                static_cast<std::uint32_t>(windowSize.cy) };
+        // A minimized window
+        if (extent.width == 0 || extent.height == 0) {
+            return false;
         }
 
-        return surfaceCapabilities.currentExtent;
-    }();
-
-    // Create a swapchain
-    const auto swapchain = [&] {
         std::vector<std::uint32_t> queueFamilyIndices
             = { graphicsQueueFamilyIndex };
         if (separatePresentQueue) {
             queueFamilyIndices.emplace_back(presentQueueFamilyIndex);
         }
 
-        const std::uint32_t minImageCount = std::max(
-            static_cast<std::uint32_t>(3), surfaceCapabilities.maxImageCount);
+        // Triple buffering when the surface allows it; a maxImageCount of 0
+        // means there is no limit
+        std::uint32_t minImageCount
+            = std::max(surfaceCapabilities.minImageCount, 3u);
+        if (surfaceCapabilities.maxImageCount > 0) {
+            minImageCount
+                = std::min(minImageCount, surfaceCapabilities.maxImageCount);
+        }
 
         vk::SharingMode imageSharingMode;
 
@@ -269,148 +373,38 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
             preTransform = surfaceCapabilities.currentTransform;
         }
 
-        return device.createSwapchainKHR({ {}, surface, minImageCount,
-            surfaceFormat.format, surfaceFormat.colorSpace, swapchainExtent, 1,
-            vk::ImageUsageFlagBits::eColorAttachment, imageSharingMode,
-            static_cast<std::uint32_t>(queueFamilyIndices.size()),
-            queueFamilyIndices.data(), preTransform,
-            vk::CompositeAlphaFlagBitsKHR::eOpaque, vk::PresentModeKHR::eFifo,
-            true });
-    }();
-
-    const auto destroySwapchain
-        = Defer([&] { device.destroySwapchainKHR(swapchain); });
+        // Passing the old swapchain lets the presentation engine hand its
+        // resources over instead of starting from scratch
+        swapchain = Retiring<vk::SwapchainKHR>(deletionQueue,
+            device.createSwapchainKHR({ {}, surface, minImageCount,
+                surfaceFormat.format, surfaceFormat.colorSpace, extent, 1,
+                vk::ImageUsageFlagBits::eColorAttachment, imageSharingMode,
+                static_cast<std::uint32_t>(queueFamilyIndices.size()),
+                queueFamilyIndices.data(), preTransform,
+                vk::CompositeAlphaFlagBitsKHR::eOpaque,
+                vk::PresentModeKHR::eFifo, true, swapchain.get() }));
 
-    const auto swapchainImages = device.getSwapchainImagesKHR(swapchain);
+        frameGraph.releaseTargets();
+        swapchainImageViews.clear();
 
-    const auto swapchainImageViews = [&] {
-        std::vector<vk::ImageView> views;
+        swapchainExtent = extent;
+        swapchainImages = device.getSwapchainImagesKHR(*swapchain);
 
         for (const auto& image : swapchainImages) {
-            views.push_back(device.createImageView(
-                { {}, image, vk::ImageViewType::e2D, surfaceFormat.format, {},
+            swapchainImageViews.emplace_back(deletionQueue,
+                device.createImageView({ {}, image, vk::ImageViewType::e2D,
+                    surfaceFormat.format, {},
                     { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } }));
         }
 
-        return views;
-    }();
-
-    const auto destroySwapchainImageViews = Defer([&] {
-        for (const auto& view : swapchainImageViews) {
-            device.destroyImageView(view);
-        }
-    });
-
-    // Setup Command buffers
-    const auto commandPool
-        = device.createCommandPool({ {}, graphicsQueueFamilyIndex });
-
-    const auto destroyCommandPool
-        = Defer([&] { device.destroyCommandPool(commandPool); });
-
-    const auto commandBuffers = device.allocateCommandBuffers(
-        { commandPool, vk::CommandBufferLevel::ePrimary,
-            static_cast<std::uint32_t>(swapchainImages.size()) });
-
-    const auto destroyCommandBuffers = Defer(
-        [&] { device.freeCommandBuffers(commandPool, commandBuffers); });
-
-    // Create depth image
-    const auto depthFormat = vk::Format::eD32Sfloat;
-    const auto depthImages = [&] {
-        std::vector<vk::Image> v(swapchainImages.size());
-
-        std::generate(v.begin(), v.end(), [&] {
-            return device.createImage({ {}, vk::ImageType::e2D, depthFormat,
-                { swapchainExtent.width, swapchainExtent.height, 1 }, 1, 1,
-                vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal,
-                vk::ImageUsageFlagBits::eDepthStencilAttachment
-                    | vk::ImageUsageFlagBits::eTransferDst,
-                vk::SharingMode::eExclusive, 0, nullptr,
-                vk::ImageLayout::eUndefined });
-        });
-
-        return v;
-    }();
-
-    const auto destroyDepthImages = Defer([&] {
-        for (const auto& image : depthImages) {
-            device.destroyImage(image);
-        }
-    });
-
-    const auto memoryProps = gpu.getMemoryProperties();
-
-    const auto getMemoryTypeIndex
-        = [&](const vk::MemoryRequirements& requirements,
-            const vk::MemoryPropertyFlags& propertyFlags) {
-
-              const auto i = std::distance(memoryProps.memoryTypes,
-                  std::find_if(memoryProps.memoryTypes,
-                      memoryProps.memoryTypes + VK_MAX_MEMORY_TYPES,
-                      [&](const auto& memoryType) {
-                          return (memoryType.propertyFlags & propertyFlags)
-                              == propertyFlags;
-                      }));
-
-              if (i == VK_MAX_MEMORY_TYPES) {
-                  throw new std::runtime_error("No appropreate memory type");
-              }
-
-              return static_cast<std::uint32_t>(i);
-          };
+        frameGraph.setExtent(extent);
 
-    const auto allocateImageMemory = [&](
-        const vk::Image& image, const vk::MemoryPropertyFlagBits& flagBit) {
-        const auto requirements = device.getImageMemoryRequirements(image);
-
-        const auto memoryTypeIndex = getMemoryTypeIndex(
-            requirements, vk::MemoryPropertyFlagBits::eDeviceLocal);
-
-        return device.allocateMemory({ requirements.size, memoryTypeIndex });
+        return true;
     };
 
-    const auto freeMemory
-        = [&](const vk::DeviceMemory& memory) { device.freeMemory(memory); };
-
-    const auto depthMemories = [&] {
-        std::vector<vk::DeviceMemory> v;
-
-        for (const auto& image : depthImages) {
-            auto memory = allocateImageMemory(
-                image, vk::MemoryPropertyFlagBits::eDeviceLocal);
-            device.bindImageMemory(image, memory, 0);
-            v.emplace_back(std::move(memory));
-        }
-
-        return v;
-    }();
-
-    const auto freeDepthMemories = Defer([&] {
-        for (const auto& memory : depthMemories) {
-            freeMemory(memory);
-        }
-    });
-
-    const auto depthImageViews = [&] {
-        std::vector<vk::ImageView> v;
-
-        for (const auto& image : depthImages) {
-            v.push_back(device.createImageView(
-                { {}, image, vk::ImageViewType::e2D, depthFormat, {},
-                    { vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 } }));
-        }
-
-        return v;
-    }();
-
-    const auto destroyDepthImageViews = Defer([&] {
-        for (const auto& imageView : depthImageViews) {
-            device.destroyImageView(imageView);
-        }
-    });
-
-    UBO ubo{ {}, {}, {} };
+    // The view and projection stay identity, so the triangle is drawn in
+    // clip space
+    UBO ubo{ glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f) };
 
     const auto uniformBuffer = device.createBuffer(
         { {}, sizeof(ubo), vk::BufferUsageFlagBits::eUniformBuffer,
@@ -420,174 +414,144 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
         = Defer([&] { device.destroyBuffer(uniformBuffer); });
 
     const auto uniformMemory = [&] {
-        const auto requirements
-            = device.getBufferMemoryRequirements(uniformBuffer);
-        auto memory = device.allocateMemory({ requirements.size,
-            getMemoryTypeIndex(requirements,
-                vk::MemoryPropertyFlagBits::eHostVisible
-                    | vk::MemoryPropertyFlagBits::eHostCoherent) });
+        const auto allocation = allocator.allocateBuffer(uniformBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible
+                | vk::MemoryPropertyFlagBits::eHostCoherent);
 
-        auto data = device.mapMemory(memory, 0, requirements.size, {});
+        std::memcpy(allocation.mapped, &ubo, sizeof(ubo));
 
-        std::memcpy(data, &ubo, sizeof(ubo));
+        return allocation;
+    }();
 
-        device.unmapMemory(memory);
+    const auto freeUniformMemory
+        = Defer([&] { allocator.free(uniformMemory); });
 
-        device.bindBufferMemory(uniformBuffer, memory, 0);
+    // The model matrix is the world matrix of the triangle's node, written
+    // straight into the uniform buffer whenever it changes. The triangle is
+    // the only node, which isn't worth more than the calling thread.
+    TransformHierarchy transforms;
+    WorkerThreads transformThreads(1);
 
-        return std::move(memory);
-    }();
+    transforms.add(TransformHierarchy::none);
+
+    vk::DescriptorSetLayout descriptorSetLayout;
+    vk::PipelineLayout pipelineLayout;
+    vk::DescriptorPool descriptorPool;
+    std::vector<vk::DescriptorSet> descriptorSets;
 
-    const auto freeUniformMemory = Defer(std::bind(freeMemory, uniformMemory));
+    const auto destroyDescriptors = Defer([&] {
+        if (!descriptorSets.empty()) {
+            device.freeDescriptorSets(descriptorPool, descriptorSets);
+        }
+        device.destroyDescriptorPool(descriptorPool);
+        device.destroyPipelineLayout(pipelineLayout);
+        device.destroyDescriptorSetLayout(descriptorSetLayout);
+    });
+
+    const vk::DescriptorBufferInfo uniformBufferInfo{ uniformBuffer, 0,
+        sizeof(ubo) };
 
-    const auto descriptorSetLayout = [&] {
+    const auto createDescriptors = [&] {
         const vk::DescriptorSetLayoutBinding binding{ 0,
             vk::DescriptorType::eUniformBuffer, 1,
             vk::ShaderStageFlagBits::eVertex, nullptr };
 
-        return device.createDescriptorSetLayout({ {}, 1, &binding });
-    }();
-
-    const auto destroyDescriptorSetLayout = Defer(
-        [&] { device.destroyDescriptorSetLayout(descriptorSetLayout); });
+        descriptorSetLayout
+            = device.createDescriptorSetLayout({ {}, 1, &binding });
 
-    const auto pipelineLayout = device.createPipelineLayout(
-        { {}, 1, &descriptorSetLayout, 0, nullptr });
-    const auto destroyPipelineLayout
-        = Defer([&] { device.destroyPipelineLayout(pipelineLayout); });
+        pipelineLayout = device.createPipelineLayout(
+            { {}, 1, &descriptorSetLayout, 0, nullptr });
 
-    const auto descriptorPool = [&] {
         const vk::DescriptorPoolSize poolSize{
             vk::DescriptorType::eUniformBuffer, 1
         };
 
-        return device.createDescriptorPool(
+        descriptorPool = device.createDescriptorPool(
             { vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 1, 1,
                 &poolSize });
-    }();
-    const auto destroyDescriptorPool
-        = Defer([&] { device.destroyDescriptorPool(descriptorPool); });
 
-    const auto descriptorSets = device.allocateDescriptorSets(
-        { descriptorPool, 1, &descriptorSetLayout });
-    const auto destroyDescriptorSets = Defer(
-        [&] { device.freeDescriptorSets(descriptorPool, descriptorSets); });
+        descriptorSets = device.allocateDescriptorSets(
+            { descriptorPool, 1, &descriptorSetLayout });
 
-    const vk::DescriptorBufferInfo uniformBufferInfo{ uniformBuffer, 0,
-        sizeof(ubo) };
-
-    device.updateDescriptorSets(
-        { { descriptorSets.at(0), 0, 0, 1, vk::DescriptorType::eUniformBuffer,
-            nullptr, &uniformBufferInfo, nullptr } },
-        nullptr);
-
-    const std::array<vk::AttachmentDescription, 2> attachments{
-        { { {}, surfaceFormat.format, vk::SampleCountFlagBits::e1,
-              vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
-              vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
-              vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR },
-            { {}, depthFormat, vk::SampleCountFlagBits::e1,
-                vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare,
-                vk::AttachmentLoadOp::eDontCare,
-                vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined,
-                vk::ImageLayout::eDepthStencilAttachmentOptimal } }
+        device.updateDescriptorSets(
+            { { descriptorSets.at(0), 0, 0, 1,
+                vk::DescriptorType::eUniformBuffer, nullptr,
+                &uniformBufferInfo, nullptr } },
+            nullptr);
     };
 
-    const vk::AttachmentReference colorReference{ 0,
-        vk::ImageLayout::eColorAttachmentOptimal };
-
-    const vk::AttachmentReference depthReference{ 1,
-        vk::ImageLayout::eDepthStencilAttachmentOptimal };
-
-    const vk::SubpassDescription subpass{ {}, vk::PipelineBindPoint::eGraphics,
-        0, nullptr, 1, &colorReference, nullptr, &depthReference, 0, nullptr };
+    constexpr const auto& fragmentShader
+        = ShaderRegistry::find(EmbeddedShaders::shaders, "shader.frag");
+    constexpr const auto& vertexShader
+        = ShaderRegistry::find(EmbeddedShaders::shaders, "shader.vert");
 
-    const auto renderPass = device.createRenderPass(
-        { {}, static_cast<std::uint32_t>(attachments.size()),
-            attachments.data(), 1, &subpass, 0, nullptr });
-
-    const auto destroyRenderPass
-        = Defer([&] { device.destroyRenderPass(renderPass); });
-
-    const auto createShaderModule = [&device](const std::string& fileName) {
-        std::ifstream file(fileName, std::ios_base::binary);
-
-        if (file.fail()) {
-            throw std::runtime_error("Can't open file");
-        }
-
-        const std::vector<char> binary{ std::istreambuf_iterator<char>(file),
-            std::istreambuf_iterator<char>() };
-
-        return device.createShaderModule(
-            { {}, static_cast<std::size_t>(binary.size() * sizeof(char)),
-                reinterpret_cast<const std::uint32_t*>(binary.data()) });
-    };
-
-    const auto fragmentShaderModule = createShaderModule("frag.spv");
-    const auto vertexShaderModule = createShaderModule("vert.spv");
+    vk::ShaderModule fragmentShaderModule;
+    vk::ShaderModule vertexShaderModule;
 
     const auto destroyShaderModules = Defer([&] {
         device.destroyShaderModule(fragmentShaderModule);
         device.destroyShaderModule(vertexShaderModule);
     });
 
-    const auto framebuffers = [&] {
-        std::vector<vk::Framebuffer> framebuffers;
+    const auto createShaderModules = [&] {
+        fragmentShaderModule
+            = ShaderRegistry::createShaderModule(device, fragmentShader);
+        vertexShaderModule
+            = ShaderRegistry::createShaderModule(device, vertexShader);
+    };
 
-        for (int i = 0; i < swapchainImages.size(); i++) {
-            const vk::ImageView attachments[]
-                = { swapchainImageViews.at(i), depthImageViews.at(i) };
-            framebuffers.emplace_back(
-                device.createFramebuffer({ {}, renderPass, 2, attachments,
-                    swapchainExtent.width, swapchainExtent.height, 1 }));
-        }
+    const Vertex vertexBufferData[]
+        = { { Snorm16x4::pack(0.0f, -0.5f, 0.0f, 1.0f),
+                Unorm8x4::pack(1.0f, 0.0f, 0.0f, 1.0f) },
+            { Snorm16x4::pack(0.5f, 0.5f, 0.0f, 1.0f),
+                Unorm8x4::pack(0.0f, 1.0f, 0.0f, 1.0f) },
+            { Snorm16x4::pack(-0.5f, 0.5f, 0.0f, 1.0f),
+                Unorm8x4::pack(0.0f, 0.0f, 1.0f, 1.0f) } };
 
-        return framebuffers;
-    }();
+    const std::uint16_t indexBufferData[] = { 0, 1, 2 };
+
+    Uploader::Buffer vertexBuffer{};
+    Uploader::Buffer indexBuffer{};
 
-    const auto destroyFrameBuffers = Defer([&] {
-        for (const auto& framebuffer : framebuffers) {
-            device.destroyFramebuffer(framebuffer);
+    const auto destroyVertexBuffer = Defer([&] {
+        if (vertexBuffer.buffer) {
+            uploader.destroyBuffer(vertexBuffer);
+        }
+        if (indexBuffer.buffer) {
+            uploader.destroyBuffer(indexBuffer);
         }
     });
 
-    const Vertex vertexBufferData[]
-        = { { { 0.0, -0.5, 0.0, 1.0 }, { 1.0, 0.0, 0.0, 1.0 } },
-            { { 0.5, 0.5, 0.0, 1.0 }, { 0.0, 1.0, 0.0, 1.0 } },
-            { { -0.5, 0.5, 0.0, 1.0 }, { 0.0, 0.0, 1.0, 1.0 } } };
-
-    const auto vertexBuffer = device.createBuffer(
-        { {}, sizeof(vertexBufferData), vk::BufferUsageFlagBits::eVertexBuffer,
-            vk::SharingMode::eExclusive, 0, nullptr });
-
-    const auto destroyVertexBuffer
-        = Defer([&] { device.destroyBuffer(vertexBuffer); });
+    // Signaled once the mesh is on the GPU; only the first draw waits for
+    // it
+    vk::Semaphore uploadSemaphore;
 
-    const auto vertexMemory = [&] {
-        const auto requirements
-            = device.getBufferMemoryRequirements(vertexBuffer);
-        auto memory = device.allocateMemory(
-            vk::MemoryAllocateInfo()
-                .setMemoryTypeIndex(getMemoryTypeIndex(requirements,
-                    vk::MemoryPropertyFlagBits::eHostVisible
-                        | vk::MemoryPropertyFlagBits::eHostCoherent))
-                .setAllocationSize(requirements.size));
+    const auto uploadMesh = [&] {
+        vertexBuffer = uploader.createBuffer(
+            sizeof(vertexBufferData), vk::BufferUsageFlagBits::eVertexBuffer);
 
-        auto data = device.mapMemory(memory, 0, requirements.size, {});
+        uploader.upload(vertexBuffer.buffer, 0, vertexBufferData,
+            sizeof(vertexBufferData));
 
-        std::memcpy(data, &vertexBufferData, sizeof(vertexBufferData));
+        indexBuffer = uploader.createBuffer(
+            sizeof(indexBufferData), vk::BufferUsageFlagBits::eIndexBuffer);
 
-        device.unmapMemory(memory);
+        uploader.upload(indexBuffer.buffer, 0, indexBufferData,
+            sizeof(indexBufferData));
 
-        device.bindBufferMemory(vertexBuffer, memory, 0);
+        uploadSemaphore = uploader.flush();
+    };
 
-        return std::move(memory);
-    }();
+    PipelineCache pipelineCache(
+        device, gpu.getProperties(), "basic.pipeline_cache");
 
-    const auto freeVertexMemory = Defer(std::bind(freeMemory, vertexMemory));
+    const auto savePipelineCache = Defer([&] {
+        if (!pipelineCache.save()) {
+            Log::print("Failed to save the pipeline cache\n");
+        }
+    });
 
-    const auto graphicsPipeline = [&] {
+    const auto createPipeline = [&] {
         const std::array<vk::PipelineShaderStageCreateInfo, 2> stages
             = { { { {}, vk::ShaderStageFlagBits::eVertex, vertexShaderModule,
                       "main", nullptr },
@@ -596,11 +560,8 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
 
         const vk::VertexInputBindingDescription vertexBindingDescription{ 0,
             sizeof(Vertex), vk::VertexInputRate::eVertex };
-        const std::array<vk::VertexInputAttributeDescription, 2>
-            vertexAttributeDescriptions{
-                { { 0, 0, vk::Format::eR32G32B32A32Sfloat, 0 },
-                    { 1, 0, vk::Format::eR32G32B32A32Sfloat, 16 } }
-            };
+        const auto vertexAttributeDescriptions = VertexFormat::attributes(
+            0, 0, &Vertex::position, &Vertex::color);
         const vk::PipelineVertexInputStateCreateInfo vertexInputState{ {}, 1,
             &vertexBindingDescription,
             static_cast<uint32_t>(vertexAttributeDescriptions.size()),
@@ -609,14 +570,10 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
         const vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState{ {},
             vk::PrimitiveTopology::eTriangleList, VK_FALSE };
 
-        // TODO: Use dynamic state instead of setting the viewport and the
-        // scissor?
-        const vk::Viewport viewport{ 0.0f, 0.0f,
-            static_cast<float>(swapchainExtent.width),
-            static_cast<float>(swapchainExtent.height), 0.0f, 1.0f };
-        const vk::Rect2D scissor{ { 0, 0 }, swapchainExtent };
+        // The viewport and the scissor are set when recording, so that the
+        // pipeline doesn't depend on the swapchain extent
         const vk::PipelineViewportStateCreateInfo viewportState{ {}, 1,
-            &viewport, 1, &scissor };
+            nullptr, 1, nullptr };
 
         const vk::PipelineRasterizationStateCreateInfo rasterizationState{ {},
             VK_TRUE, VK_FALSE, vk::PolygonMode::eFill,
@@ -640,65 +597,195 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int)
         const vk::PipelineColorBlendStateCreateInfo colorBlendState{ {},
             VK_FALSE, vk::LogicOp::eNoOp, 1, &attachment, { 1.0f } };
 
-        return device.createGraphicsPipeline(nullptr,
+        const std::array<vk::DynamicState, 2> dynamicStates
+            = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+        const vk::PipelineDynamicStateCreateInfo dynamicState{ {},
+            static_cast<std::uint32_t>(dynamicStates.size()),
+            dynamicStates.data() };
+
+        return device.createGraphicsPipeline(pipelineCache.handle(),
             { {}, static_cast<uint32_t>(stages.size()), stages.data(),
                 &vertexInputState, &inputAssemblyState, nullptr, &viewportState,
                 &rasterizationState, &multisampleState, &depthStencilState,
-                &colorBlendState, nullptr, pipelineLayout, renderPass, 0,
-                nullptr, 0 });
-    }();
+                &colorBlendState, &dynamicState, pipelineLayout,
+                frameGraph.renderPass(scenePass), 0, nullptr, 0 });
+    };
+
+    vk::Pipeline graphicsPipeline;
 
     const auto destroyPipeline
         = Defer([&] { device.destroyPipeline(graphicsPipeline); });
 
+    frameGraph.setRecord(
+        scenePass, [&](const RenderGraph::PassContext& context) {
+            const auto& commandBuffer = context.commandBuffer;
+
+            commandBuffer.bindPipeline(
+                vk::PipelineBindPoint::eGraphics, graphicsPipeline);
+            commandBuffer.setViewport(0,
+                { { 0.0f, 0.0f, static_cast<float>(context.extent.width),
+                    static_cast<float>(context.extent.height), 0.0f,
+                    1.0f } });
+            commandBuffer.setScissor(0, { { { 0, 0 }, context.extent } });
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                pipelineLayout, 0, descriptorSets, nullptr);
+            commandBuffer.bindVertexBuffers(
+                0, { vertexBuffer.buffer }, { 0 });
+            commandBuffer.bindIndexBuffer(
+                indexBuffer.buffer, 0, vk::IndexType::eUint16);
+            commandBuffer.drawIndexed(3, 1, 0, 0, 0);
+        });
+
+    // Setup Command buffers
+    const auto commandPool = device.createCommandPool(
+        { vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+            graphicsQueueFamilyIndex });
+
+    const auto destroyCommandPool
+        = Defer([&] { device.destroyCommandPool(commandPool); });
+
+    // Every draw waits for the GPU, so one command buffer is enough
+    const auto commandBuffer = device.allocateCommandBuffers(
+        { commandPool, vk::CommandBufferLevel::ePrimary, 1 }).at(0);
+
     const auto imageAcquiredSemaphore = device.createSemaphore({});
 
     const auto destroyImageAcquiredSemaphore
         = Defer([&] { device.destroySemaphore(imageAcquiredSemaphore); });
 
-    std::uint32_t currentImageIndex;
-    device.acquireNextImageKHR(
-        swapchain, UINT64_MAX, imageAcquiredSemaphore, {}, &currentImageIndex);
+    const auto drawFence = device.createFence({ vk::FenceCreateFlags{} });
+    const auto destroyDrawFence
+        = Defer([&] { device.destroyFence(drawFence); });
 
-    const auto& commandBuffer = commandBuffers.at(currentImageIndex);
+    // Set when the swapchain no longer matches the surface
+    bool swapchainStale = false;
+
+    // Independent startup work runs on worker threads as soon as what it
+    // depends on is ready
+    {
+        TaskGraph startup;
+
+        const auto renderPassTask
+            = startup.add("render_pass", createRenderPass);
+        startup.add("swapchain",
+            [&] { swapchainStale = !createSwapchain(); }, { renderPassTask });
+        const auto descriptorsTask
+            = startup.add("descriptors", createDescriptors);
+        const auto shaderModulesTask
+            = startup.add("shader_modules", createShaderModules);
+        startup.add("mesh_upload", uploadMesh);
+        startup.add("pipeline",
+            [&] {
+                graphicsPipeline = createPipeline();
+                Log::print("Pipeline created with a %s cache\n",
+                    pipelineCache.warm() ? "warm" : "cold");
+            },
+            { renderPassTask, descriptorsTask, shaderModulesTask });
+
+        startup.run();
+        startup.printTimeline("Startup");
+    }
+
+    // Logs the time from the start of main() to the first presented frame,
+    // which parallel startup is meant to shorten
+    bool firstFrameLogged = false;
+    const auto logTimeToFirstFrame = [&] {
+        if (firstFrameLogged) {
+            return;
+        }
 
-    const std::array<vk::ClearValue, 2> clearValues
-        = { vk::ClearColorValue{}, vk::ClearDepthStencilValue{ 1.0f, 0 } };
+        firstFrameLogged = true;
 
-    vk::CommandBufferBeginInfo beginInfo{ {}, nullptr };
-    commandBuffer.begin(beginInfo);
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - startupBegin;
+        Log::print("Time to first frame: %.3f ms\n", elapsed.count());
+    };
 
-    commandBuffer.beginRenderPass(
-        { renderPass, framebuffers.at(currentImageIndex),
-            { { 0, 0 }, swapchainExtent },
-            static_cast<std::uint32_t>(clearValues.size()),
-            clearValues.data() },
-        vk::SubpassContents::eInline);
+    // Frames submitted so far. Each draw waits for its frame, so the frame
+    // is also the last one completed once a draw returns.
+    std::uint64_t frameNumber = 0;
 
-    commandBuffer.bindPipeline(
-        vk::PipelineBindPoint::eGraphics, graphicsPipeline);
-    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-        pipelineLayout, 0, descriptorSets, nullptr);
-    commandBuffer.bindVertexBuffers(0, { vertexBuffer }, { 0 });
-    commandBuffer.draw(3, 1, 0, 0);
+    const auto draw = [&] {
+        if (swapchainStale || platform.extent() != swapchainExtent) {
+            swapchainStale = !createSwapchain();
 
-    commandBuffer.endRenderPass();
+            if (swapchainStale) {
+                return;
+            }
+        }
 
-    commandBuffer.end();
+        std::uint32_t currentImageIndex;
+        const auto acquireResult = device.acquireNextImageKHR(*swapchain,
+            UINT64_MAX, imageAcquiredSemaphore, {}, &currentImageIndex);
 
-    const auto drawFence = device.createFence({ vk::FenceCreateFlags{} });
-    const auto destroyDrawFence
-        = Defer([&] { device.destroyFence(drawFence); });
+        if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
+            // Nothing was acquired, so the semaphore stays unsignaled
+            swapchainStale = true;
+            platform.requestRedraw();
+            return;
+        }
 
-    const vk::PipelineStageFlags waitDstStageMask
-        = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-    graphicsQueue.submit({ { 1, &imageAcquiredSemaphore, &waitDstStageMask, 1,
-                             &commandBuffer, 0, nullptr } },
-        drawFence);
+        if (acquireResult != vk::Result::eSuccess
+            && acquireResult != vk::Result::eSuboptimalKHR) {
+            throw std::runtime_error("Failed to acquire a swapchain image");
+        }
+
+        // The previous draw has completed, so the GPU isn't reading the
+        // uniform buffer
+        transforms.update(transformThreads,
+            uniformMemory.mapped + offsetof(UBO, model), sizeof(UBO));
+
+        deletionQueue.advance(++frameNumber);
+
+        vk::CommandBufferBeginInfo beginInfo{
+            vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr
+        };
+        commandBuffer.begin(beginInfo);
+
+        frameGraph.setImage(colorTarget, swapchainImages.at(currentImageIndex),
+            *swapchainImageViews.at(currentImageIndex));
+        frameGraph.execute(commandBuffer, 0);
+
+        commandBuffer.end();
+
+        // The first draw also waits for the vertex upload
+        const std::array<vk::Semaphore, 2> waitSemaphores
+            = { imageAcquiredSemaphore, uploadSemaphore };
+        const std::array<vk::PipelineStageFlags, 2> waitDstStageMasks
+            = { vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                  vk::PipelineStageFlagBits::eVertexInput };
+        const std::uint32_t waitCount = uploadSemaphore ? 2 : 1;
+        graphicsQueue.submit(
+            { { waitCount, waitSemaphores.data(), waitDstStageMasks.data(), 1,
+                &commandBuffer, 0, nullptr } },
+            drawFence);
+        uploadSemaphore = vk::Semaphore{};
+
+        device.waitForFences({ drawFence }, VK_TRUE, UINT64_MAX);
+        device.resetFences({ drawFence });
+        deletionQueue.collect(frameNumber);
+
+        const vk::PresentInfoKHR presentInfo{ 0, nullptr, 1, &*swapchain,
+            &currentImageIndex };
+        const auto presentResult = presentQueue.presentKHR(&presentInfo);
+
+        logTimeToFirstFrame();
+
+        if (presentResult == vk::Result::eErrorOutOfDateKHR
+            || presentResult == vk::Result::eSuboptimalKHR) {
+            swapchainStale = true;
+            platform.requestRedraw();
+        } else if (presentResult != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to present");
+        }
+    };
 
-    device.waitForFences({ drawFence }, VK_FALSE, 1'000'000'000);
+    const auto exitCode = platform.run([&] {
+        draw();
+        return true;
+    });
 
-    presentQueue.presentKHR({ 0, nullptr, 1, &swapchain, &currentImageIndex });
+    device.waitIdle();
 
-    WindowsHelper::mainLoop();
+    return exitCode;
 }
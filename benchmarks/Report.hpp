@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Benchmark results, written as JSON with one result per line so that a run
+// can be compared against a stored baseline with a plain line diff.
+class Report {
+ public:
+  using Fields = std::vector<std::pair<std::string, double>>;
+
+  void setDevice(const std::string& name) { m_device = name; }
+
+  void add(const std::string& name, const Fields& fields) {
+    m_results.push_back({name, fields});
+  }
+
+  void write(std::FILE* out) const {
+    std::fprintf(out, "{\"device\":\"%s\",\"results\":[",
+                 escape(m_device).c_str());
+
+    for (std::size_t i = 0; i < m_results.size(); i++) {
+      const auto& result = m_results[i];
+
+      std::fprintf(out, "%s\n{\"name\":\"%s\"", i == 0 ? "" : ",",
+                   escape(result.first).c_str());
+
+      for (const auto& field : result.second) {
+        // Counts are printed as integers, timings with fixed precision
+        const auto value = field.second;
+        const bool integral =
+            value == std::floor(value) && std::fabs(value) < 9.0e15;
+
+        std::fprintf(out, integral ? ",\"%s\":%.0f" : ",\"%s\":%.4f",
+                     escape(field.first).c_str(), value);
+      }
+
+      std::fprintf(out, "}");
+    }
+
+    std::fprintf(out, "\n]}\n");
+  }
+
+ private:
+  static std::string escape(const std::string& s) {
+    std::string escaped;
+
+    for (const auto c : s) {
+      if (c == '"' || c == '\\') {
+        escaped += '\\';
+      }
+      escaped += c;
+    }
+
+    return escaped;
+  }
+
+  std::string m_device;
+  std::vector<std::pair<std::string, Fields>> m_results;
+};
+
+// Runs f and returns the elapsed wall-clock time in milliseconds
+template <typename F>
+double measureMs(F&& f) {
+  const auto begin = std::chrono::steady_clock::now();
+  f();
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - begin;
+
+  return elapsed.count();
+}
@@ -0,0 +1,1318 @@
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glm/mat4x4.hpp"
+
+#include "Defer.hpp"
+#include "EmbeddedShaders.hpp"
+#include "FrustumCuller.hpp"
+#include "GpuProfiler.hpp"
+#include "MemoryAllocator.hpp"
+#include "MeshOptimizer.hpp"
+#include "RecordingScheduler.hpp"
+#include "Report.hpp"
+#include "ShaderLoader.hpp"
+#include "StreamBuffer.hpp"
+#include "TransformHierarchy.hpp"
+#include "TransientAttachmentPool.hpp"
+#include "UniformRing.hpp"
+#include "Uploader.hpp"
+#include "VertexFormat.hpp"
+
+// Headless benchmarks of the startup stages, buffer uploads and steady-state
+// frames of the animation sample's renderer.
+//
+//   benchmarks [--device index] [--frames count] [--output file.json]
+//
+// Without --device, a CPU (software) implementation is preferred when one is
+// installed, so that results are comparable across CI machines.
+
+namespace {
+
+struct Vertex {
+  Snorm16x4 position;
+  Unorm8x4 color;
+};
+
+struct Instance {
+  // Offset in xy, scale in z and rotation in radians in w
+  float transform[4];
+  float color[4];
+};
+
+// Per-frame parameters of animate.comp. The members after reset are only
+// read by the sample's culling pass.
+struct UBO {
+  float time;
+  float deltaTime;
+  std::uint32_t instanceCount;
+  std::uint32_t reset;
+  float meshRadius;
+  std::uint32_t indexCount;
+  float gridOffset[2];
+  float frustumPlanes[6][4];
+};
+
+// Where the per-instance data of a frame comes from
+enum class Animation {
+  // Written by the CPU into a stream buffer every frame
+  eStreamed,
+  // Advanced on the GPU by animate.comp, as in the sample
+  eCompute,
+};
+
+// What a frame draws: count vertices, or count indices of indexType when
+// there is an index buffer
+struct Geometry {
+  vk::Buffer vertexBuffer;
+  vk::Buffer indexBuffer;
+  vk::IndexType indexType;
+  std::uint32_t count;
+};
+
+// A grid of small triangles covering the render target, wound like the
+// sample's triangle
+std::vector<Vertex> makeTriangles(std::uint32_t count) {
+  const auto columns = static_cast<std::uint32_t>(
+      std::ceil(std::sqrt(static_cast<double>(count))));
+  const auto rows = (count + columns - 1) / columns;
+  const float width = 2.0f / columns;
+  const float height = 2.0f / rows;
+
+  std::vector<Vertex> vertices;
+  vertices.reserve(count * 3);
+
+  for (std::uint32_t i = 0; i < count; i++) {
+    const float left = -1.0f + (i % columns) * width;
+    const float top = -1.0f + (i / columns) * height;
+    const float shade = static_cast<float>(i) / count;
+
+    vertices.push_back({Snorm16x4::pack(left + width * 0.5f, top, 0.0f, 1.0f),
+                        Unorm8x4::pack(1.0f, shade, 0.0f, 1.0f)});
+    vertices.push_back(
+        {Snorm16x4::pack(left + width, top + height, 0.0f, 1.0f),
+         Unorm8x4::pack(0.0f, 1.0f, shade, 1.0f)});
+    vertices.push_back({Snorm16x4::pack(left, top + height, 0.0f, 1.0f),
+                        Unorm8x4::pack(shade, 0.0f, 1.0f, 1.0f)});
+  }
+
+  return vertices;
+}
+
+// An indexed mesh as a modeling tool would export it, before packing
+struct SourceMesh {
+  struct Vertex {
+    float position[3];
+    float color[4];
+  };
+
+  std::vector<Vertex> vertices;
+  std::vector<std::uint32_t> indices;
+};
+
+// A sphere filling the render target, with its depth in [0, 1], generated
+// ring by ring
+SourceMesh makeSphere(std::uint32_t segments, std::uint32_t rings) {
+  const float pi = 3.14159265f;
+
+  SourceMesh mesh;
+  mesh.vertices.reserve((segments + 1) * (rings + 1));
+  mesh.indices.reserve(segments * rings * 6);
+
+  for (std::uint32_t ring = 0; ring <= rings; ring++) {
+    const float theta = pi * ring / rings;
+
+    for (std::uint32_t segment = 0; segment <= segments; segment++) {
+      const float phi = 2.0f * pi * segment / segments;
+      const float x = std::sin(theta) * std::cos(phi);
+      const float y = std::sin(theta) * std::sin(phi);
+      const float z = std::cos(theta);
+
+      mesh.vertices.push_back({{x * 0.9f, y * 0.9f, 0.5f + z * 0.45f},
+                               {x * 0.5f + 0.5f, y * 0.5f + 0.5f,
+                                z * 0.5f + 0.5f, 1.0f}});
+    }
+  }
+
+  for (std::uint32_t ring = 0; ring < rings; ring++) {
+    for (std::uint32_t segment = 0; segment < segments; segment++) {
+      const auto topLeft = ring * (segments + 1) + segment;
+      const auto bottomLeft = topLeft + segments + 1;
+
+      mesh.indices.insert(mesh.indices.end(),
+                          {topLeft, bottomLeft, topLeft + 1, topLeft + 1,
+                           bottomLeft, bottomLeft + 1});
+    }
+  }
+
+  return mesh;
+}
+
+// Lays count instances out on a square grid over the render target, each
+// scaled down to its cell. A single instance keeps the mesh as it is.
+void writeInstances(Instance* instances, std::uint32_t count) {
+  const auto columns = static_cast<std::uint32_t>(
+      std::ceil(std::sqrt(static_cast<double>(count))));
+  const float cellSize = 2.0f / columns;
+
+  for (std::uint32_t i = 0; i < count; i++) {
+    instances[i] = {{-1.0f + cellSize * (i % columns + 0.5f),
+                     -1.0f + cellSize * (i / columns + 0.5f), cellSize * 0.5f,
+                     0.0f},
+                    {1.0f, 1.0f, 1.0f, 1.0f}};
+  }
+}
+
+// Scatters count spheres around the clip volume, so that a few percent of
+// them are inside. The seed is fixed to keep runs comparable.
+BoundingSpheres makeSpheres(std::uint32_t count) {
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(-4.0f, 4.0f);
+  std::uniform_real_distribution<float> radius(0.0f, 0.05f);
+
+  BoundingSpheres spheres;
+  spheres.resize(count);
+
+  for (std::uint32_t i = 0; i < count; i++) {
+    spheres.set(i, position(random), position(random), position(random),
+                radius(random));
+  }
+
+  return spheres;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::int32_t deviceIndex = -1;
+  std::uint32_t frameCount = 100;
+  std::string outputPath;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string option = argv[i];
+
+    if (option == "--device") {
+      deviceIndex = std::stoi(argv[i + 1]);
+    } else if (option == "--frames") {
+      frameCount = static_cast<std::uint32_t>(std::stoul(argv[i + 1]));
+    } else if (option == "--output") {
+      outputPath = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "Unknown option %s\n", option.c_str());
+      return 1;
+    }
+  }
+
+  const std::uint32_t framesInFlight = 2;
+  const std::uint32_t warmupFrameCount = 10;
+
+  Report report;
+
+  // Startup: instance
+  vk::Instance instance;
+
+  const auto instanceMs = measureMs([&] {
+    const vk::ApplicationInfo appInfo{nullptr, 0, nullptr, 0,
+                                      VK_API_VERSION_1_0};
+
+    instance = vk::createInstance({{}, &appInfo, 0, nullptr, 0, nullptr});
+  });
+
+  report.add("startup.instance", {{"ms", instanceMs}});
+
+  const auto destroyInstance = Defer([&] { instance.destroy(); });
+
+  // Startup: physical and logical device
+  vk::PhysicalDevice gpu;
+  std::uint32_t queueFamilyIndex = 0;
+  vk::Device device;
+
+  const auto deviceMs = measureMs([&] {
+    const auto gpus = instance.enumeratePhysicalDevices();
+
+    if (gpus.size() == 0) {
+      throw std::runtime_error("No physical device");
+    }
+
+    if (deviceIndex >= 0) {
+      gpu = gpus.at(static_cast<std::size_t>(deviceIndex));
+    } else {
+      const auto cpu = std::find_if(
+          gpus.cbegin(), gpus.cend(), [](const auto& candidate) {
+            return candidate.getProperties().deviceType ==
+                   vk::PhysicalDeviceType::eCpu;
+          });
+
+      gpu = cpu != gpus.cend() ? *cpu : gpus.at(0);
+    }
+
+    const auto queueFamilyProperties = gpu.getQueueFamilyProperties();
+    const auto i = std::distance(
+        queueFamilyProperties.cbegin(),
+        std::find_if(queueFamilyProperties.cbegin(),
+                     queueFamilyProperties.cend(), [](const auto& prop) {
+                       const auto wanted = vk::QueueFlagBits::eGraphics |
+                                           vk::QueueFlagBits::eCompute;
+                       return (prop.queueFlags & wanted) == wanted;
+                     }));
+
+    if (i == queueFamilyProperties.size()) {
+      throw std::runtime_error("No graphics and compute operation support");
+    }
+
+    queueFamilyIndex = static_cast<std::uint32_t>(i);
+
+    const float queuePriority = 0.0f;
+    const vk::DeviceQueueCreateInfo queueCreateInfo{
+        {}, queueFamilyIndex, 1, &queuePriority};
+    const auto features = gpu.getFeatures();
+
+    device = gpu.createDevice(
+        {{}, 1, &queueCreateInfo, 0, nullptr, 0, nullptr, &features});
+  });
+
+  report.add("startup.device", {{"ms", deviceMs}});
+
+  const auto destroyDevice = Defer([&] { device.destroy(); });
+
+  report.setDevice(gpu.getProperties().deviceName);
+
+  const auto queue = device.getQueue(queueFamilyIndex, 0);
+
+  MemoryAllocator allocator(device, gpu);
+  Uploader uploader(device, allocator, queue, queueFamilyIndex,
+                    queueFamilyIndex);
+
+  // Startup: offscreen render target
+  const auto colorFormat = vk::Format::eB8G8R8A8Unorm;
+  const vk::Extent2D renderExtent{720, 480};
+
+  std::vector<vk::Image> colorImages(framesInFlight);
+  std::vector<MemoryAllocator::Allocation> colorMemories;
+  std::vector<vk::ImageView> colorImageViews;
+  vk::RenderPass renderPass;
+  std::vector<vk::Framebuffer> framebuffers;
+
+  const auto offscreenTargetMs = measureMs([&] {
+    for (auto& image : colorImages) {
+      image = device.createImage(
+          {{},
+           vk::ImageType::e2D,
+           colorFormat,
+           {renderExtent.width, renderExtent.height, 1},
+           1,
+           1,
+           vk::SampleCountFlagBits::e1,
+           vk::ImageTiling::eOptimal,
+           vk::ImageUsageFlagBits::eColorAttachment |
+               vk::ImageUsageFlagBits::eTransferSrc,
+           vk::SharingMode::eExclusive,
+           0,
+           nullptr,
+           vk::ImageLayout::eUndefined});
+
+      colorMemories.push_back(allocator.allocateImage(
+          image, vk::MemoryPropertyFlagBits::eDeviceLocal));
+
+      colorImageViews.push_back(device.createImageView(
+          {{},
+           image,
+           vk::ImageViewType::e2D,
+           colorFormat,
+           {},
+           {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}}));
+    }
+
+    const vk::AttachmentDescription attachment{
+        {},
+        colorFormat,
+        vk::SampleCountFlagBits::e1,
+        vk::AttachmentLoadOp::eClear,
+        vk::AttachmentStoreOp::eStore,
+        vk::AttachmentLoadOp::eDontCare,
+        vk::AttachmentStoreOp::eDontCare,
+        vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eTransferSrcOptimal};
+
+    const vk::AttachmentReference colorReference{
+        0, vk::ImageLayout::eColorAttachmentOptimal};
+
+    const vk::SubpassDescription subpass{
+        {},      vk::PipelineBindPoint::eGraphics,
+        0,       nullptr,
+        1,       &colorReference,
+        nullptr, nullptr,
+        0,       nullptr};
+
+    renderPass =
+        device.createRenderPass({{}, 1, &attachment, 1, &subpass, 0, nullptr});
+
+    for (const auto& view : colorImageViews) {
+      framebuffers.push_back(device.createFramebuffer(
+          {{}, renderPass, 1, &view, renderExtent.width, renderExtent.height,
+           1}));
+    }
+  });
+
+  report.add("startup.offscreen_target", {{"ms", offscreenTargetMs}});
+
+  const auto destroyOffscreenTarget = Defer([&] {
+    for (const auto& framebuffer : framebuffers) {
+      device.destroyFramebuffer(framebuffer);
+    }
+    device.destroyRenderPass(renderPass);
+    for (const auto& view : colorImageViews) {
+      device.destroyImageView(view);
+    }
+    for (const auto& image : colorImages) {
+      device.destroyImage(image);
+    }
+    for (const auto& memory : colorMemories) {
+      allocator.free(memory);
+    }
+  });
+
+  // Depth memory at 4K with triple buffering: one depth image per swapchain
+  // image, as the samples used to have, against one transient depth image
+  // per frame in flight from the pool
+  {
+    const auto depthFormat = vk::Format::eD32Sfloat;
+    const vk::Extent2D extent4k{3840, 2160};
+    const std::uint32_t swapchainImageCount = 3;
+
+    TransientAttachmentPool transientAttachments(device, allocator);
+
+    for (std::uint32_t i = 0; i < framesInFlight; i++) {
+      transientAttachments.add(depthFormat, extent4k,
+                               vk::ImageUsageFlagBits::eDepthStencilAttachment,
+                               vk::ImageAspectFlagBits::eDepth);
+    }
+    transientAttachments.allocate();
+
+    const auto& pool = transientAttachments.report();
+    const auto imageBytes = pool.requiredBytes / pool.attachmentCount;
+
+    report.add("depth_memory",
+               {{"width", static_cast<double>(extent4k.width)},
+                {"height", static_cast<double>(extent4k.height)},
+                {"swapchain_images", static_cast<double>(swapchainImageCount)},
+                {"frames_in_flight", static_cast<double>(framesInFlight)},
+                {"per_image_bytes",
+                 static_cast<double>(imageBytes * swapchainImageCount)},
+                {"pool_bytes", static_cast<double>(pool.allocatedBytes)},
+                {"lazy_bytes", static_cast<double>(pool.lazyBytes)}});
+  }
+
+  // Startup: shader modules from the embedded SPIR-V
+  constexpr const auto& fragmentShader =
+      ShaderRegistry::find(EmbeddedShaders::shaders, "shader.frag");
+  constexpr const auto& vertexShader =
+      ShaderRegistry::find(EmbeddedShaders::shaders, "shader.vert");
+  constexpr const auto& computeShader =
+      ShaderRegistry::find(EmbeddedShaders::shaders, "animate.comp");
+
+  vk::ShaderModule fragmentShaderModule;
+  vk::ShaderModule vertexShaderModule;
+  vk::ShaderModule computeShaderModule;
+
+  const auto shaderModulesMs = measureMs([&] {
+    fragmentShaderModule =
+        ShaderRegistry::createShaderModule(device, fragmentShader);
+    vertexShaderModule =
+        ShaderRegistry::createShaderModule(device, vertexShader);
+    computeShaderModule =
+        ShaderRegistry::createShaderModule(device, computeShader);
+  });
+
+  report.add("startup.shader_modules", {{"ms", shaderModulesMs}});
+
+  const auto destroyShaderModules = Defer([&] {
+    device.destroyShaderModule(fragmentShaderModule);
+    device.destroyShaderModule(vertexShaderModule);
+    device.destroyShaderModule(computeShaderModule);
+  });
+
+  // Shader loading from disk. The time per module should stay flat as the
+  // number of modules grows. Mapping, validating and reading every word of
+  // padded files, from the page cache, shows how loading scales with size.
+  {
+    const auto writeShader = [](const std::string& path,
+                                const std::uint32_t* code, std::size_t size,
+                                std::size_t paddedSize) {
+      std::ofstream file(path, std::ios_base::binary | std::ios_base::trunc);
+      file.write(reinterpret_cast<const char*>(code),
+                 static_cast<std::streamsize>(size));
+
+      // OpNop words, which pad a file without changing what it does
+      const std::uint32_t nop = 0x00010000;
+      for (auto written = size; written < paddedSize; written += sizeof(nop)) {
+        file.write(reinterpret_cast<const char*>(&nop), sizeof(nop));
+      }
+    };
+
+    for (const std::uint32_t count : {1u, 8u, 64u, 256u}) {
+      std::vector<std::string> paths;
+
+      for (std::uint32_t i = 0; i < count; i++) {
+        paths.push_back("benchmark_shader_" + std::to_string(i) + ".spv");
+        writeShader(paths.back(), vertexShader.code, vertexShader.size,
+                    vertexShader.size);
+      }
+
+      std::vector<vk::ShaderModule> modules;
+      const auto ms = measureMs(
+          [&] { modules = ShaderLoader::createShaderModules(device, paths); });
+
+      for (const auto& module : modules) {
+        device.destroyShaderModule(module);
+      }
+
+      for (const auto& path : paths) {
+        std::remove(path.c_str());
+      }
+
+      report.add("shader_load", {{"modules", static_cast<double>(count)},
+                                 {"ms", ms},
+                                 {"ms_per_module", ms / count}});
+    }
+
+    for (const std::size_t size : {std::size_t{16} << 10, std::size_t{1} << 20,
+                                   std::size_t{16} << 20}) {
+      const std::string path = "benchmark_shader_padded.spv";
+      writeShader(path, vertexShader.code, vertexShader.size, size);
+
+      // Summing every word makes each page of the mapping load, and checks
+      // that it holds what was written
+      const auto wordSum = [](const std::uint32_t* words, std::size_t bytes) {
+        return std::accumulate(words, words + bytes / sizeof(std::uint32_t),
+                               std::uint32_t{0});
+      };
+
+      std::uint32_t sum = 0;
+      const auto ms = measureMs([&] {
+        const SpirvFile file(path);
+        sum = wordSum(file.code(), file.size());
+      });
+
+      std::remove(path.c_str());
+
+      const std::uint32_t nop = 0x00010000;
+      const auto expectedSum =
+          wordSum(vertexShader.code, vertexShader.size) +
+          nop * static_cast<std::uint32_t>((size - vertexShader.size) /
+                                           sizeof(nop));
+
+      if (sum != expectedSum) {
+        throw std::runtime_error("Mapped shader differs from the file written");
+      }
+
+      report.add("shader_map",
+                 {{"bytes", static_cast<double>(size)},
+                  {"ms", ms},
+                  {"mib_per_s", size / 1048576.0 / (ms / 1000.0)}});
+    }
+  }
+
+  // Pipeline. The set is only used by the compute pass.
+  const auto descriptorSetLayout = [&] {
+    const std::array<vk::DescriptorSetLayoutBinding, 2> bindings{
+        {{0, vk::DescriptorType::eUniformBufferDynamic, 1,
+          vk::ShaderStageFlagBits::eCompute, nullptr},
+         {1, vk::DescriptorType::eStorageBuffer, 1,
+          vk::ShaderStageFlagBits::eCompute, nullptr}}};
+
+    return device.createDescriptorSetLayout(
+        {{}, static_cast<std::uint32_t>(bindings.size()), bindings.data()});
+  }();
+
+  const auto destroyDescriptorSetLayout =
+      Defer([&] { device.destroyDescriptorSetLayout(descriptorSetLayout); });
+
+  const auto pipelineLayout =
+      device.createPipelineLayout({{}, 1, &descriptorSetLayout, 0, nullptr});
+  const auto destroyPipelineLayout =
+      Defer([&] { device.destroyPipelineLayout(pipelineLayout); });
+
+  const auto createPipeline = [&](const vk::PipelineCache& cache) {
+    const std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+        {{{},
+          vk::ShaderStageFlagBits::eVertex,
+          vertexShaderModule,
+          "main",
+          nullptr},
+         {{},
+          vk::ShaderStageFlagBits::eFragment,
+          fragmentShaderModule,
+          "main",
+          nullptr}}};
+
+    const std::array<vk::VertexInputBindingDescription, 2>
+        vertexBindingDescriptions{
+            {{0, sizeof(Vertex), vk::VertexInputRate::eVertex},
+             {1, sizeof(Instance), vk::VertexInputRate::eInstance}}};
+    const auto vertexAttributes = VertexFormat::attributes(
+        0, 0, &Vertex::position, &Vertex::color);
+    const auto instanceAttributes = VertexFormat::attributes(
+        1, 2, &Instance::transform, &Instance::color);
+
+    std::vector<vk::VertexInputAttributeDescription>
+        vertexAttributeDescriptions(vertexAttributes.begin(),
+                                    vertexAttributes.end());
+    vertexAttributeDescriptions.insert(vertexAttributeDescriptions.end(),
+                                       instanceAttributes.begin(),
+                                       instanceAttributes.end());
+    const vk::PipelineVertexInputStateCreateInfo vertexInputState{
+        {},
+        static_cast<uint32_t>(vertexBindingDescriptions.size()),
+        vertexBindingDescriptions.data(),
+        static_cast<uint32_t>(vertexAttributeDescriptions.size()),
+        vertexAttributeDescriptions.data()};
+
+    const vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState{
+        {}, vk::PrimitiveTopology::eTriangleList, VK_FALSE};
+
+    const vk::Viewport viewport{0.0f,
+                                0.0f,
+                                static_cast<float>(renderExtent.width),
+                                static_cast<float>(renderExtent.height),
+                                0.0f,
+                                1.0f};
+    const vk::Rect2D scissor{{0, 0}, renderExtent};
+    const vk::PipelineViewportStateCreateInfo viewportState{
+        {}, 1, &viewport, 1, &scissor};
+
+    const vk::PipelineRasterizationStateCreateInfo rasterizationState{
+        {},
+        VK_FALSE,
+        VK_FALSE,
+        vk::PolygonMode::eFill,
+        vk::CullModeFlagBits::eBack,
+        vk::FrontFace::eClockwise,
+        VK_FALSE,
+        0.0f,
+        0.0f,
+        0.0f,
+        1.0f};
+
+    const vk::PipelineMultisampleStateCreateInfo multisampleState{
+        {},      vk::SampleCountFlagBits::e1, VK_FALSE, 0.0f, nullptr, VK_FALSE,
+        VK_FALSE};
+
+    const vk::PipelineColorBlendAttachmentState attachment{
+        VK_FALSE,
+        vk::BlendFactor::eZero,
+        vk::BlendFactor::eZero,
+        vk::BlendOp::eAdd,
+        vk::BlendFactor::eZero,
+        vk::BlendFactor::eZero,
+        vk::BlendOp::eAdd,
+        vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA};
+    const vk::PipelineColorBlendStateCreateInfo colorBlendState{
+        {}, VK_FALSE, vk::LogicOp::eNoOp, 1, &attachment, {1.0f}};
+
+    return device.createGraphicsPipeline(cache,
+                                         {{},
+                                          static_cast<uint32_t>(stages.size()),
+                                          stages.data(),
+                                          &vertexInputState,
+                                          &inputAssemblyState,
+                                          nullptr,
+                                          &viewportState,
+                                          &rasterizationState,
+                                          &multisampleState,
+                                          nullptr,
+                                          &colorBlendState,
+                                          nullptr,
+                                          pipelineLayout,
+                                          renderPass,
+                                          0,
+                                          nullptr,
+                                          0});
+  };
+
+  // Startup: pipeline creation, first with an empty cache and then again
+  // with the cache the first creation filled
+  const auto pipelineCache = device.createPipelineCache({{}, 0, nullptr});
+  const auto destroyPipelineCache =
+      Defer([&] { device.destroyPipelineCache(pipelineCache); });
+
+  vk::Pipeline graphicsPipeline;
+
+  const auto coldPipelineMs =
+      measureMs([&] { graphicsPipeline = createPipeline(pipelineCache); });
+
+  device.destroyPipeline(graphicsPipeline);
+
+  const auto warmPipelineMs =
+      measureMs([&] { graphicsPipeline = createPipeline(pipelineCache); });
+
+  report.add("startup.pipeline_cold", {{"ms", coldPipelineMs}});
+  report.add("startup.pipeline_warm", {{"ms", warmPipelineMs}});
+
+  const auto destroyPipeline =
+      Defer([&] { device.destroyPipeline(graphicsPipeline); });
+
+  // Work groups of animate.comp
+  const std::uint32_t computeGroupSize = 64;
+
+  vk::Pipeline computePipeline;
+
+  const auto computePipelineMs = measureMs([&] {
+    computePipeline = device.createComputePipeline(
+        pipelineCache,
+        {{},
+         {{}, vk::ShaderStageFlagBits::eCompute, computeShaderModule, "main",
+          nullptr},
+         pipelineLayout,
+         {},
+         0});
+  });
+
+  report.add("startup.compute_pipeline", {{"ms", computePipelineMs}});
+
+  const auto destroyComputePipeline =
+      Defer([&] { device.destroyPipeline(computePipeline); });
+
+  // A wait-only submission that consumes the semaphore returned by
+  // Uploader::flush() and blocks until the uploads have completed
+  const auto uploadFence = device.createFence({});
+  const auto destroyUploadFence =
+      Defer([&] { device.destroyFence(uploadFence); });
+
+  const auto waitForUploads = [&](const vk::Semaphore& semaphore) {
+    if (!semaphore) {
+      return;
+    }
+
+    const vk::PipelineStageFlags waitDstStageMask =
+        vk::PipelineStageFlagBits::eAllCommands;
+    queue.submit({{1, &semaphore, &waitDstStageMask, 0, nullptr, 0, nullptr}},
+                 uploadFence);
+    device.waitForFences({uploadFence}, VK_TRUE, UINT64_MAX);
+    device.resetFences({uploadFence});
+  };
+
+  // Uploads through the staging ring into device-local buffers
+  for (const vk::DeviceSize size :
+       {vk::DeviceSize{64} << 10, vk::DeviceSize{1} << 20,
+        vk::DeviceSize{16} << 20, vk::DeviceSize{64} << 20}) {
+    const std::vector<char> data(static_cast<std::size_t>(size), 1);
+    const auto buffer =
+        uploader.createBuffer(size, vk::BufferUsageFlagBits::eVertexBuffer);
+
+    const auto ms = measureMs([&] {
+      uploader.upload(buffer.buffer, 0, data.data(), size);
+      waitForUploads(uploader.flush());
+    });
+
+    uploader.destroyBuffer(buffer);
+
+    report.add("upload", {{"bytes", static_cast<double>(size)},
+                          {"ms", ms},
+                          {"mib_per_s", size / 1048576.0 / (ms / 1000.0)}});
+  }
+
+  // Parameters of the compute pass, streamed as in the sample
+  UniformRing uniformRing(
+      device, allocator,
+      gpu.getProperties().limits.minUniformBufferOffsetAlignment, 64 * 1024,
+      framesInFlight);
+
+  const auto descriptorPool = [&] {
+    const std::array<vk::DescriptorPoolSize, 2> poolSizes{
+        {{vk::DescriptorType::eUniformBufferDynamic, 1},
+         {vk::DescriptorType::eStorageBuffer, 1}}};
+
+    return device.createDescriptorPool(
+        {{}, 1, static_cast<std::uint32_t>(poolSizes.size()),
+         poolSizes.data()});
+  }();
+  const auto destroyDescriptorPool =
+      Defer([&] { device.destroyDescriptorPool(descriptorPool); });
+
+  const auto descriptorSets =
+      device.allocateDescriptorSets({descriptorPool, 1, &descriptorSetLayout});
+
+  // The instance buffer is written for each frame benchmark that uses it
+  const vk::DescriptorBufferInfo uniformBufferInfo{uniformRing.buffer(), 0,
+                                                   sizeof(UBO)};
+  device.updateDescriptorSets(
+      {{descriptorSets.at(0), 0, 0, 1,
+        vk::DescriptorType::eUniformBufferDynamic, nullptr, &uniformBufferInfo,
+        nullptr}},
+      nullptr);
+
+  // Per-frame resources
+  const auto commandPools = [&] {
+    std::vector<vk::CommandPool> v(framesInFlight);
+
+    std::generate(v.begin(), v.end(), [&] {
+      return device.createCommandPool(
+          {vk::CommandPoolCreateFlagBits::eTransient, queueFamilyIndex});
+    });
+
+    return v;
+  }();
+
+  const auto destroyCommandPools = Defer([&] {
+    for (const auto& pool : commandPools) {
+      device.destroyCommandPool(pool);
+    }
+  });
+
+  const auto commandBuffers = [&] {
+    std::vector<vk::CommandBuffer> v;
+
+    for (const auto& pool : commandPools) {
+      v.push_back(device.allocateCommandBuffers(
+                            {pool, vk::CommandBufferLevel::ePrimary, 1})
+                      .at(0));
+    }
+
+    return v;
+  }();
+
+  const auto drawFences = [&] {
+    std::vector<vk::Fence> v(framesInFlight);
+
+    std::generate(v.begin(), v.end(), [&] {
+      return device.createFence({vk::FenceCreateFlagBits::eSignaled});
+    });
+
+    return v;
+  }();
+
+  const auto destroyDrawFences = Defer([&] {
+    for (const auto& fence : drawFences) {
+      device.destroyFence(fence);
+    }
+  });
+
+  GpuProfiler profiler(device, gpu, queueFamilyIndex, framesInFlight);
+
+  // Renders frameCount frames after a warm-up and reports the mean wall-clock
+  // time per frame, CPU time and GPU time of the frame's passes. The CPU time
+  // covers producing the instances as well as recording.
+  //
+  // The vertices, or the indices of an indexed mesh, are split into
+  // drawCount draws. They are recorded inline when threadCount is 0, and
+  // otherwise into secondary command buffers by that many threads.
+  const auto runFrames = [&](const Geometry& geometry,
+                             std::uint32_t instanceCount,
+                             std::uint32_t drawCount = 1,
+                             std::uint32_t threadCount = 0,
+                             Animation animation = Animation::eStreamed) {
+    std::unique_ptr<StreamBuffer> instanceStream;
+    vk::Buffer instanceBuffer;
+    MemoryAllocator::Allocation instanceMemory;
+
+    if (animation == Animation::eStreamed) {
+      // Each frame's instances start at a whole instance
+      instanceStream = std::make_unique<StreamBuffer>(
+          device, allocator, vk::BufferUsageFlagBits::eVertexBuffer,
+          sizeof(Instance), sizeof(Instance) * instanceCount, framesInFlight);
+    } else {
+      instanceBuffer = device.createBuffer(
+          {{}, sizeof(Instance) * instanceCount,
+           vk::BufferUsageFlagBits::eStorageBuffer |
+               vk::BufferUsageFlagBits::eVertexBuffer,
+           vk::SharingMode::eExclusive, 0, nullptr});
+      instanceMemory = allocator.allocateBuffer(
+          instanceBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+      const vk::DescriptorBufferInfo instanceBufferInfo{instanceBuffer, 0,
+                                                        VK_WHOLE_SIZE};
+      device.updateDescriptorSets(
+          {{descriptorSets.at(0), 1, 0, 1, vk::DescriptorType::eStorageBuffer,
+            nullptr, &instanceBufferInfo, nullptr}},
+          nullptr);
+    }
+
+    const auto destroyInstanceBuffer = Defer([&] {
+      if (instanceBuffer) {
+        device.destroyBuffer(instanceBuffer);
+        allocator.free(instanceMemory);
+      }
+    });
+
+    std::unique_ptr<RecordingScheduler> scheduler;
+    if (threadCount > 0) {
+      scheduler = std::make_unique<RecordingScheduler>(
+          device, queueFamilyIndex, framesInFlight, threadCount);
+    }
+
+    const auto countPerDraw = geometry.count / drawCount;
+    vk::Buffer instances = instanceBuffer;
+    vk::DeviceSize instanceOffset = 0;
+
+    const auto recordDraws = [&](const vk::CommandBuffer& commandBuffer,
+                                 std::uint32_t first, std::uint32_t count) {
+      commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                 graphicsPipeline);
+      commandBuffer.bindVertexBuffers(0, {geometry.vertexBuffer, instances},
+                                      {0, instanceOffset});
+
+      if (geometry.indexBuffer) {
+        commandBuffer.bindIndexBuffer(geometry.indexBuffer, 0,
+                                      geometry.indexType);
+      }
+
+      for (auto draw = first; draw < first + count; draw++) {
+        if (geometry.indexBuffer) {
+          commandBuffer.drawIndexed(countPerDraw, instanceCount,
+                                    draw * countPerDraw, 0, 0);
+        } else {
+          commandBuffer.draw(countPerDraw, instanceCount, draw * countPerDraw,
+                             0);
+        }
+      }
+    };
+
+    const auto record = [&](std::uint32_t frameIndex, std::uint32_t frame) {
+      std::uint32_t uniformOffset = 0;
+
+      if (instanceStream) {
+        instanceStream->beginFrame(frameIndex);
+        const auto range =
+            instanceStream->reserve(sizeof(Instance) * instanceCount);
+        writeInstances(reinterpret_cast<Instance*>(range.data),
+                       instanceCount);
+        instances = instanceStream->buffer();
+        instanceOffset = range.offset;
+      } else {
+        // A fixed time step keeps the runs comparable
+        const float deltaTime = 1.0f / 60.0f;
+
+        uniformRing.beginFrame(frameIndex);
+        uniformOffset = uniformRing.push(UBO{frame * deltaTime, deltaTime,
+                                             instanceCount,
+                                             frame == 0 ? 1u : 0u});
+      }
+
+      const auto& commandBuffer = commandBuffers.at(frameIndex);
+      const vk::ClearValue clearValue = vk::ClearColorValue{};
+
+      commandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+                           nullptr});
+
+      profiler.beginFrame(commandBuffer, frameIndex);
+
+      if (!instanceStream) {
+        const auto animationRegion =
+            profiler.beginRegion(commandBuffer, "animation");
+
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eVertexInput |
+                vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eComputeShader, {},
+            {{vk::AccessFlagBits::eShaderWrite,
+              vk::AccessFlagBits::eShaderRead |
+                  vk::AccessFlagBits::eShaderWrite}},
+            nullptr, nullptr);
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                   computePipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                         pipelineLayout, 0, descriptorSets,
+                                         uniformOffset);
+        commandBuffer.dispatch(
+            (instanceCount + computeGroupSize - 1) / computeGroupSize, 1, 1);
+
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eVertexInput, {},
+            {{vk::AccessFlagBits::eShaderWrite,
+              vk::AccessFlagBits::eVertexAttributeRead}},
+            nullptr, nullptr);
+
+        profiler.endRegion(commandBuffer, animationRegion);
+      }
+
+      const auto region = profiler.beginRegion(commandBuffer, "render_pass");
+
+      const auto contents = scheduler
+                                ? vk::SubpassContents::eSecondaryCommandBuffers
+                                : vk::SubpassContents::eInline;
+
+      commandBuffer.beginRenderPass({renderPass,
+                                     framebuffers.at(frameIndex),
+                                     {{0, 0}, renderExtent},
+                                     1,
+                                     &clearValue},
+                                    contents);
+
+      if (scheduler) {
+        const vk::CommandBufferInheritanceInfo inheritance{
+            renderPass, 0, framebuffers.at(frameIndex), VK_FALSE, {},
+            profiler.inheritedStatistics()};
+
+        scheduler->beginFrame(frameIndex);
+        commandBuffer.executeCommands(
+            scheduler->record(inheritance, drawCount, recordDraws));
+      } else {
+        recordDraws(commandBuffer, 0, drawCount);
+      }
+
+      commandBuffer.endRenderPass();
+
+      profiler.endRegion(commandBuffer, region);
+
+      commandBuffer.end();
+    };
+
+    double cpuMs = 0.0;
+    double gpuMs = 0.0;
+    std::uint32_t gpuFrameCount = 0;
+
+    const auto collect = [&](std::uint32_t frameIndex, bool measured) {
+      const auto profile = profiler.collect(frameIndex);
+
+      if (measured && profile != nullptr) {
+        gpuMs += profile->gpuMs();
+        gpuFrameCount++;
+      }
+    };
+
+    const auto totalFrameCount = warmupFrameCount + frameCount;
+    auto begin = std::chrono::steady_clock::now();
+
+    for (std::uint32_t frame = 0; frame < totalFrameCount; frame++) {
+      const auto frameIndex = frame % framesInFlight;
+
+      if (frame == warmupFrameCount) {
+        begin = std::chrono::steady_clock::now();
+      }
+
+      device.waitForFences({drawFences.at(frameIndex)}, VK_TRUE, UINT64_MAX);
+
+      // The frame that last used this slot was measured if it came after
+      // the warm-up
+      collect(frameIndex, frame >= warmupFrameCount + framesInFlight);
+
+      const auto recordMs = measureMs([&] {
+        device.resetFences({drawFences.at(frameIndex)});
+        device.resetCommandPool(commandPools.at(frameIndex), {});
+        record(frameIndex, frame);
+      });
+
+      if (frame >= warmupFrameCount) {
+        cpuMs += recordMs;
+      }
+
+      queue.submit({{0, nullptr, nullptr, 1, &commandBuffers.at(frameIndex), 0,
+                     nullptr}},
+                   drawFences.at(frameIndex));
+    }
+
+    for (std::uint32_t frame = totalFrameCount - framesInFlight;
+         frame < totalFrameCount; frame++) {
+      const auto frameIndex = frame % framesInFlight;
+
+      device.waitForFences({drawFences.at(frameIndex)}, VK_TRUE, UINT64_MAX);
+      collect(frameIndex, frame >= warmupFrameCount);
+    }
+
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - begin;
+
+    return Report::Fields{
+        {"frame_ms", elapsed.count() / frameCount},
+        {"cpu_ms", cpuMs / frameCount},
+        {"gpu_ms", gpuFrameCount > 0 ? gpuMs / gpuFrameCount : 0.0}};
+  };
+
+  // Steady-state frames across triangle counts with a single instance, and
+  // across instance counts of a single triangle. Instances are rewritten
+  // every frame.
+  struct FrameConfig {
+    std::uint32_t triangles;
+    std::uint32_t instances;
+  };
+
+  const FrameConfig frameConfigs[] = {
+      {1, 1},      {1000, 1},    {100000, 1}, {1000000, 1},
+      {1, 10},     {1, 100},     {1, 1000},   {1, 10000},
+      {1, 100000}, {1, 1000000}};
+
+  for (const auto& config : frameConfigs) {
+    const auto vertices = makeTriangles(config.triangles);
+    const auto size = vertices.size() * sizeof(Vertex);
+
+    const auto vertexBuffer =
+        uploader.createBuffer(size, vk::BufferUsageFlagBits::eVertexBuffer);
+    uploader.upload(vertexBuffer.buffer, 0, vertices.data(), size);
+    waitForUploads(uploader.flush());
+
+    auto fields = runFrames(
+        {vertexBuffer.buffer, {}, vk::IndexType::eUint16,
+         static_cast<std::uint32_t>(vertices.size())},
+        config.instances);
+    fields.insert(fields.begin(),
+                  {{"triangles", static_cast<double>(config.triangles)},
+                   {"instances", static_cast<double>(config.instances)}});
+    report.add("frame", fields);
+
+    uploader.destroyBuffer(vertexBuffer);
+  }
+
+  // Instances animated by the compute pass instead of streamed by the CPU.
+  // The CPU time should stay flat as the instance count grows.
+  {
+    const auto vertices = makeTriangles(1);
+    const auto size = vertices.size() * sizeof(Vertex);
+
+    const auto vertexBuffer =
+        uploader.createBuffer(size, vk::BufferUsageFlagBits::eVertexBuffer);
+    uploader.upload(vertexBuffer.buffer, 0, vertices.data(), size);
+    waitForUploads(uploader.flush());
+
+    for (const std::uint32_t instances : {1u, 1000u, 100000u, 1000000u}) {
+      auto fields = runFrames(
+          {vertexBuffer.buffer, {}, vk::IndexType::eUint16,
+           static_cast<std::uint32_t>(vertices.size())},
+          instances, 1, 0, Animation::eCompute);
+      fields.insert(fields.begin(),
+                    {{"instances", static_cast<double>(instances)}});
+      report.add("compute_animation", fields);
+    }
+
+    uploader.destroyBuffer(vertexBuffer);
+  }
+
+  // Indexed meshes in packed vertices, in the order they were generated and
+  // after the offline optimizations. Memory is compared with the same
+  // triangles as non-indexed vertices of two vec4s.
+  for (const auto& size : {std::array<std::uint32_t, 2>{64, 32},
+                           std::array<std::uint32_t, 2>{1024, 512}}) {
+    const auto source = makeSphere(size[0], size[1]);
+    const auto triangleCount = source.indices.size() / 3;
+
+    for (const bool optimized : {false, true}) {
+      auto sourceVertices = source.vertices;
+      auto indices = source.indices;
+
+      const auto optimizeMs = measureMs([&] {
+        if (!optimized) {
+          return;
+        }
+
+        indices =
+            MeshOptimizer::optimizeVertexCache(indices, sourceVertices.size());
+        MeshOptimizer::optimizeOverdraw(indices,
+                                        sourceVertices.front().position,
+                                        sizeof(SourceMesh::Vertex),
+                                        sourceVertices.size());
+        MeshOptimizer::optimizeVertexFetch(indices, sourceVertices);
+      });
+
+      const auto cache =
+          MeshOptimizer::analyzeVertexCache(indices, sourceVertices.size());
+
+      std::vector<Vertex> vertices;
+      vertices.reserve(sourceVertices.size());
+      for (const auto& vertex : sourceVertices) {
+        const auto& p = vertex.position;
+        const auto& c = vertex.color;
+        vertices.push_back({Snorm16x4::pack(p[0], p[1], p[2], 1.0f),
+                            Unorm8x4::pack(c[0], c[1], c[2], c[3])});
+      }
+
+      const auto packedIndices =
+          VertexFormat::packIndices(indices, vertices.size());
+
+      const auto vertexBytes = vertices.size() * sizeof(Vertex);
+      const auto indexBytes = packedIndices.data.size();
+
+      const auto vertexBuffer = uploader.createBuffer(
+          vertexBytes, vk::BufferUsageFlagBits::eVertexBuffer);
+      const auto indexBuffer = uploader.createBuffer(
+          indexBytes, vk::BufferUsageFlagBits::eIndexBuffer);
+      uploader.upload(vertexBuffer.buffer, 0, vertices.data(), vertexBytes);
+      uploader.upload(indexBuffer.buffer, 0, packedIndices.data.data(),
+                      indexBytes);
+      waitForUploads(uploader.flush());
+
+      auto fields = runFrames({vertexBuffer.buffer, indexBuffer.buffer,
+                               packedIndices.type, packedIndices.count},
+                              1);
+      fields.insert(
+          fields.begin(),
+          {{"triangles", static_cast<double>(triangleCount)},
+           {"optimized", optimized ? 1.0 : 0.0},
+           {"optimize_ms", optimizeMs},
+           {"acmr", cache.acmr},
+           {"vertex_bytes", static_cast<double>(vertexBytes)},
+           {"index_bytes", static_cast<double>(indexBytes)},
+           {"unindexed_float_bytes",
+            static_cast<double>(triangleCount * 3 * 2 * sizeof(float[4]))}});
+      report.add("mesh", fields);
+
+      uploader.destroyBuffer(indexBuffer);
+      uploader.destroyBuffer(vertexBuffer);
+    }
+  }
+
+  // Thread counts the multithreaded CPU work is measured with
+  const auto threadCounts = [] {
+    const auto coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<std::uint32_t> v;
+    for (std::uint32_t threads = 1; threads < coreCount; threads *= 2) {
+      v.push_back(threads);
+    }
+    v.push_back(coreCount);
+
+    return v;
+  }();
+
+  // Recording many small draws across threads. The CPU time should go down
+  // as threads are added, up to the number of cores.
+  {
+    for (const std::uint32_t drawCount : {10000u, 100000u}) {
+      const auto vertices = makeTriangles(drawCount);
+      const auto size = vertices.size() * sizeof(Vertex);
+
+      const auto vertexBuffer =
+          uploader.createBuffer(size, vk::BufferUsageFlagBits::eVertexBuffer);
+      uploader.upload(vertexBuffer.buffer, 0, vertices.data(), size);
+      waitForUploads(uploader.flush());
+
+      for (const auto threads : threadCounts) {
+        auto fields = runFrames(
+            {vertexBuffer.buffer, {}, vk::IndexType::eUint16,
+             static_cast<std::uint32_t>(vertices.size())},
+            1, drawCount, threads);
+        fields.insert(fields.begin(),
+                      {{"draws", static_cast<double>(drawCount)},
+                       {"threads", static_cast<double>(threads)}});
+        report.add("recording", fields);
+      }
+
+      uploader.destroyBuffer(vertexBuffer);
+    }
+  }
+
+  // Frustum culling of bounding spheres on the CPU, as the animation sample
+  // does without multiDrawIndirect. The time should go down as threads are
+  // added, until memory bandwidth runs out.
+  {
+    const Frustum frustum{{{1.0f, 0.0f, 0.0f, 1.0f},
+                           {-1.0f, 0.0f, 0.0f, 1.0f},
+                           {0.0f, 1.0f, 0.0f, 1.0f},
+                           {0.0f, -1.0f, 0.0f, 1.0f},
+                           {0.0f, 0.0f, 1.0f, 0.0f},
+                           {0.0f, 0.0f, -1.0f, 1.0f}}};
+    const std::uint32_t repeatCount = 10;
+
+    for (const std::uint32_t objects : {100000u, 1000000u, 10000000u}) {
+      const auto spheres = makeSpheres(objects);
+
+      for (const auto threads : threadCounts) {
+        FrustumCuller culler(threads);
+
+        // Sizes the output lists
+        auto visible = culler.cull(spheres, frustum).size();
+
+        const auto totalMs = measureMs([&] {
+          for (std::uint32_t i = 0; i < repeatCount; i++) {
+            visible = culler.cull(spheres, frustum).size();
+          }
+        });
+
+        report.add("culling",
+                   {{"objects", static_cast<double>(objects)},
+                    {"threads", static_cast<double>(threads)},
+                    {"simd_width", static_cast<double>(FrustumCuller::width)},
+                    {"visible", static_cast<double>(visible)},
+                    {"ms", totalMs / repeatCount}});
+      }
+    }
+  }
+
+  // Transform updates of a large scene in which few nodes move. The time
+  // should follow the number of moved nodes and their descendants rather
+  // than the size of the scene.
+  {
+    const std::uint32_t nodeCount = 100000;
+    const std::uint32_t updateCount = 100;
+
+    const auto translation = [](float x, float y, float z) {
+      glm::mat4 m(1.0f);
+      m[3] = glm::vec4(x, y, z, 1.0f);
+      return m;
+    };
+
+    for (const std::uint32_t moved : {10u, 100u, 1000u, nodeCount}) {
+      for (const auto threads : threadCounts) {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+
+        // Each node is parented to a random earlier node, which gives a
+        // shallow tree with subtrees of all sizes
+        TransformHierarchy hierarchy;
+        hierarchy.add(TransformHierarchy::none);
+        for (std::uint32_t i = 1; i < nodeCount; i++) {
+          hierarchy.add(random() % i,
+                        translation(offset(random), offset(random), 0.0f));
+        }
+
+        // Stands in for a mapped storage buffer
+        std::vector<glm::mat4> output(nodeCount);
+
+        WorkerThreads workers(threads);
+        hierarchy.update(workers, output.data());
+
+        std::size_t updated = 0;
+        double totalMs = 0.0;
+
+        for (std::uint32_t i = 0; i < updateCount; i++) {
+          for (std::uint32_t j = 0; j < moved; j++) {
+            hierarchy.setLocal(
+                moved == nodeCount ? j : random() % nodeCount,
+                translation(offset(random), offset(random), 0.0f));
+          }
+
+          totalMs += measureMs(
+              [&] { updated += hierarchy.update(workers, output.data()); });
+        }
+
+        report.add("transforms",
+                   {{"nodes", static_cast<double>(nodeCount)},
+                    {"moved", static_cast<double>(moved)},
+                    {"threads", static_cast<double>(threads)},
+                    {"updated", static_cast<double>(updated / updateCount)},
+                    {"ms", totalMs / updateCount}});
+      }
+    }
+  }
+
+  device.waitIdle();
+
+  if (outputPath.empty()) {
+    report.write(stdout);
+  } else if (auto file = std::fopen(outputPath.c_str(), "w")) {
+    report.write(file);
+    std::fclose(file);
+  } else {
+    std::fprintf(stderr, "Can't open %s\n", outputPath.c_str());
+    return 1;
+  }
+
+  return 0;
+}
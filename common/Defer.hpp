@@ -1,19 +1,49 @@
-#include <functional>
+#pragma once
 
-class Defer {
+#include <type_traits>
+#include <utility>
+
+// Calls a function when it goes out of scope, for cleanup that has to run
+// however the scope is left:
+//
+//   const auto destroyPool = Defer([&] { device.destroyCommandPool(pool); });
+//
+// The function is kept as its own type rather than in a std::function, so
+// deferring it doesn't allocate.
+template <typename Function>
+class Deferred {
 public:
-    explicit Defer(const std::function<void()>& defered) noexcept
-        : m_defered(defered)
+    explicit Deferred(Function function) noexcept
+        : m_function(std::move(function))
     {
     }
 
-    explicit Defer(std::function<void()>&& defered) noexcept
-        : m_defered(defered)
+    Deferred(Deferred&& other) noexcept
+        : m_function(std::move(other.m_function))
+        , m_armed(other.m_armed)
     {
+        other.m_armed = false;
     }
 
-    ~Defer() { m_defered(); }
+    Deferred(const Deferred&) = delete;
+    Deferred& operator=(const Deferred&) = delete;
+    Deferred& operator=(Deferred&&) = delete;
+
+    ~Deferred()
+    {
+        if (m_armed) {
+            m_function();
+        }
+    }
 
 private:
-    std::function<void()> m_defered;
+    Function m_function;
+    bool m_armed = true;
 };
+
+template <typename Function>
+Deferred<typename std::decay<Function>::type> Defer(Function&& function)
+{
+    return Deferred<typename std::decay<Function>::type>(
+        std::forward<Function>(function));
+}
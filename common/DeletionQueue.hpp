@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <tuple>
+
+#include "MemoryAllocator.hpp"
+
+// Destroys Vulkan objects once the GPU is done with them, instead of waiting
+// for the device to go idle.
+//
+// Objects are retired with the value of the latest submission that may use
+// them, e.g. a frame number or a timeline semaphore value, and destroyed by
+// collect() once that value has completed. Values must not decrease.
+// Whatever is left is destroyed with the queue, by which time the GPU must
+// be done with it.
+class DeletionQueue {
+public:
+    DeletionQueue(const vk::Device& device, MemoryAllocator& allocator)
+        : m_device(device)
+        , m_allocator(allocator)
+    {
+    }
+
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    ~DeletionQueue() { collect(m_value); }
+
+    // Objects retired from now on may be used by the submission that
+    // completes value
+    void advance(std::uint64_t value) { m_value = value; }
+
+    template <typename Handle>
+    void retire(const Handle& handle)
+    {
+        std::get<std::deque<Retired<Handle>>>(m_retired).push_back(
+            { m_value, handle });
+    }
+
+    // Destroys every object retired with completedValue or earlier
+    void collect(std::uint64_t completedValue)
+    {
+        collect<vk::Buffer>(completedValue);
+        collect<vk::Framebuffer>(completedValue);
+        collect<vk::ImageView>(completedValue);
+        collect<vk::Image>(completedValue);
+        collect<vk::Pipeline>(completedValue);
+        collect<vk::RenderPass>(completedValue);
+        collect<vk::SwapchainKHR>(completedValue);
+        // Last, as the objects above may be bound to it
+        collect<MemoryAllocator::Allocation>(completedValue);
+    }
+
+private:
+    template <typename Handle>
+    struct Retired {
+        std::uint64_t value;
+        Handle handle;
+    };
+
+    template <typename Handle>
+    void collect(std::uint64_t completedValue)
+    {
+        auto& retired = std::get<std::deque<Retired<Handle>>>(m_retired);
+
+        while (!retired.empty() && retired.front().value <= completedValue) {
+            destroy(retired.front().handle);
+            retired.pop_front();
+        }
+    }
+
+    void destroy(const vk::Buffer& buffer) { m_device.destroyBuffer(buffer); }
+
+    void destroy(const vk::Framebuffer& framebuffer)
+    {
+        m_device.destroyFramebuffer(framebuffer);
+    }
+
+    void destroy(const vk::ImageView& view) { m_device.destroyImageView(view); }
+
+    void destroy(const vk::Image& image) { m_device.destroyImage(image); }
+
+    void destroy(const vk::Pipeline& pipeline)
+    {
+        m_device.destroyPipeline(pipeline);
+    }
+
+    void destroy(const vk::RenderPass& renderPass)
+    {
+        m_device.destroyRenderPass(renderPass);
+    }
+
+    void destroy(const vk::SwapchainKHR& swapchain)
+    {
+        m_device.destroySwapchainKHR(swapchain);
+    }
+
+    void destroy(const MemoryAllocator::Allocation& allocation)
+    {
+        m_allocator.free(allocation);
+    }
+
+    vk::Device m_device;
+    MemoryAllocator& m_allocator;
+
+    std::uint64_t m_value = 0;
+    std::tuple<std::deque<Retired<vk::Buffer>>,
+        std::deque<Retired<vk::Framebuffer>>,
+        std::deque<Retired<vk::ImageView>>, std::deque<Retired<vk::Image>>,
+        std::deque<Retired<vk::Pipeline>>, std::deque<Retired<vk::RenderPass>>,
+        std::deque<Retired<vk::SwapchainKHR>>,
+        std::deque<Retired<MemoryAllocator::Allocation>>>
+        m_retired;
+};
+
+// A Vulkan object owned by one place, which is retired to a DeletionQueue
+// when replaced or destroyed rather than destroyed on the spot. It holds the
+// handle and a pointer to the queue, nothing else.
+template <typename Handle>
+class Retiring {
+public:
+    Retiring() = default;
+
+    Retiring(DeletionQueue& queue, const Handle& handle) noexcept
+        : m_queue(&queue)
+        , m_handle(handle)
+    {
+    }
+
+    Retiring(Retiring&& other) noexcept
+        : m_queue(other.m_queue)
+        , m_handle(other.release())
+    {
+    }
+
+    Retiring& operator=(Retiring&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            m_queue = other.m_queue;
+            m_handle = other.release();
+        }
+
+        return *this;
+    }
+
+    Retiring(const Retiring&) = delete;
+    Retiring& operator=(const Retiring&) = delete;
+
+    ~Retiring() { reset(); }
+
+    const Handle& get() const { return m_handle; }
+    const Handle& operator*() const { return m_handle; }
+    explicit operator bool() const { return static_cast<bool>(m_handle); }
+
+    // Gives up the handle without retiring it
+    Handle release() noexcept
+    {
+        const auto handle = m_handle;
+        m_handle = Handle{};
+        return handle;
+    }
+
+    void reset()
+    {
+        if (m_handle) {
+            m_queue->retire(release());
+        }
+    }
+
+private:
+    DeletionQueue* m_queue = nullptr;
+    Handle m_handle;
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "TripleBuffer.hpp"
+
+// Advances a simulation on its own thread in fixed steps, independent of the
+// frame rate, and publishes its state after each step through a triple
+// buffer. The render thread never waits for a step, so a slow one delays
+// the simulation but never presentation.
+//
+// Steps are due at a fixed interval from the start. Steps that fall behind
+// run back to back to catch up, up to maxCatchUp of them; beyond that the
+// schedule restarts from now and the simulation runs slower than real time.
+//
+// Rendering interpolates between the last two states, one step behind the
+// simulation, so that motion stays smooth whatever the two rates are.
+template <typename State>
+class FixedStepSimulation {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Advances state by one step of the given length in seconds. It runs on
+    // the simulation thread and must not touch shared state without
+    // synchronization.
+    using StepFunction = std::function<void(State& state, double step)>;
+
+    // The two latest states and how far rendering is between them, from 0
+    // at previous to 1 at current
+    struct Sample {
+        const State& previous;
+        const State& current;
+        double alpha;
+        // When the step that computed current was due, e.g. to measure the
+        // latency from simulation to display
+        Clock::time_point due;
+    };
+
+    FixedStepSimulation(const State& initial, double stepRate,
+        StepFunction step, std::uint32_t maxCatchUp = 5)
+        : m_step(std::move(step))
+        , m_interval(std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double>(1.0 / stepRate)))
+        , m_maxCatchUp(std::max(maxCatchUp, 1u))
+        , m_snapshots({ initial, initial, Clock::now(), nullptr })
+        , m_thread([this, initial] { run(initial); })
+    {
+    }
+
+    FixedStepSimulation(const FixedStepSimulation&) = delete;
+    FixedStepSimulation& operator=(const FixedStepSimulation&) = delete;
+
+    ~FixedStepSimulation()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_stopped.notify_all();
+
+        m_thread.join();
+    }
+
+    // The states to render at now, which remain valid until the next call.
+    // Only one thread may sample. Rethrows what the step function threw.
+    Sample sample(Clock::time_point now = Clock::now())
+    {
+        const auto& snapshot = m_snapshots.read();
+
+        if (snapshot.error) {
+            std::rethrow_exception(snapshot.error);
+        }
+
+        const std::chrono::duration<double> sinceDue = now - snapshot.due;
+        const auto alpha = sinceDue.count()
+            / std::chrono::duration<double>(m_interval).count();
+
+        return { snapshot.previous, snapshot.current,
+            std::min(std::max(alpha, 0.0), 1.0), snapshot.due };
+    }
+
+private:
+    struct Snapshot {
+        State previous;
+        State current;
+        // When current was due, the time at which rendering starts moving
+        // towards it
+        Clock::time_point due;
+        std::exception_ptr error;
+    };
+
+    void run(State state)
+    {
+        const auto stepSeconds
+            = std::chrono::duration<double>(m_interval).count();
+        auto due = Clock::now() + m_interval;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (!m_stopped.wait_until(lock, due, [this] { return m_stop; })) {
+            lock.unlock();
+
+            auto& snapshot = m_snapshots.back();
+            snapshot.previous = state;
+
+            try {
+                m_step(state, stepSeconds);
+            } catch (...) {
+                snapshot.error = std::current_exception();
+                m_snapshots.publish();
+                return;
+            }
+
+            snapshot.current = state;
+            snapshot.due = due;
+            m_snapshots.publish();
+
+            due += m_interval;
+
+            const auto now = Clock::now();
+            if (now - due > m_interval * m_maxCatchUp) {
+                due = now;
+            }
+
+            lock.lock();
+        }
+    }
+
+    StepFunction m_step;
+    Clock::duration m_interval;
+    std::uint32_t m_maxCatchUp;
+
+    TripleBuffer<Snapshot> m_snapshots;
+
+    std::mutex m_mutex;
+    std::condition_variable m_stopped;
+    bool m_stop = false;
+
+    std::thread m_thread;
+};
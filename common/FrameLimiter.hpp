@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+// Spaces frames at a fixed interval. A frame that starts late moves the
+// schedule instead of making the following frames catch up.
+class FrameLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // A rate of zero or less disables limiting
+    explicit FrameLimiter(double maxFrameRate)
+        : m_interval(maxFrameRate > 0.0
+                  ? std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(1.0 / maxFrameRate))
+                  : Clock::duration::zero())
+        , m_deadline(Clock::now())
+    {
+    }
+
+    // When the next frame is due
+    Clock::time_point deadline() const { return m_deadline; }
+
+    bool due() const { return Clock::now() >= m_deadline; }
+
+    // Milliseconds until the next frame is due, rounded up so that a wait of
+    // that length never wakes up early
+    unsigned long remainingMs() const
+    {
+        const auto remaining = m_deadline - Clock::now();
+
+        if (remaining <= Clock::duration::zero()) {
+            return 0;
+        }
+
+        return static_cast<unsigned long>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                remaining + std::chrono::milliseconds(1)
+                - Clock::duration(1))
+                .count());
+    }
+
+    // Schedules the frame after the one starting now
+    void advance()
+    {
+        m_deadline = std::max(m_deadline, Clock::now()) + m_interval;
+    }
+
+private:
+    Clock::duration m_interval;
+    Clock::time_point m_deadline;
+};
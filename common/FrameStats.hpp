@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+// Prints the mean, median, 99th percentile and maximum of values as a CSV
+// comment line
+static inline void printPercentiles(
+    std::FILE* out, const char* name, std::vector<double> values)
+{
+    if (values.empty()) {
+        return;
+    }
+
+    double sum = 0.0;
+    for (const auto value : values) {
+        sum += value;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    const auto percentile = [&values](double p) {
+        return values.at(static_cast<std::size_t>(p * (values.size() - 1)));
+    };
+
+    std::fprintf(out, "# %s mean=%.4f p50=%.4f p99=%.4f max=%.4f\n", name,
+        sum / values.size(), percentile(0.5), percentile(0.99), values.back());
+}
+
+// Collects per-frame timings and prints them as CSV followed by a summary.
+class FrameStats {
+public:
+    struct Frame {
+        double cpuMs;
+        double gpuMs;
+        double fenceWaitMs;
+    };
+
+    void add(const Frame& frame) { m_frames.push_back(frame); }
+
+    // Wall-clock time spent on all frames, used to report throughput
+    void setElapsed(double ms) { m_elapsedMs = ms; }
+
+    void print(std::FILE* out) const
+    {
+        std::fprintf(out, "frame,cpu_ms,gpu_ms,fence_wait_ms\n");
+
+        for (std::size_t i = 0; i < m_frames.size(); i++) {
+            std::fprintf(out, "%zu,%.4f,%.4f,%.4f\n", i, m_frames[i].cpuMs,
+                m_frames[i].gpuMs, m_frames[i].fenceWaitMs);
+        }
+
+        printSummary(out, "cpu_ms", &Frame::cpuMs);
+        printSummary(out, "gpu_ms", &Frame::gpuMs);
+        printSummary(out, "fence_wait_ms", &Frame::fenceWaitMs);
+
+        if (m_elapsedMs > 0.0) {
+            std::fprintf(out, "# frames=%zu elapsed_ms=%.4f fps=%.2f\n",
+                m_frames.size(), m_elapsedMs,
+                m_frames.size() * 1000.0 / m_elapsedMs);
+        }
+    }
+
+private:
+    void printSummary(
+        std::FILE* out, const char* name, double Frame::*field) const
+    {
+        std::vector<double> values;
+        values.reserve(m_frames.size());
+
+        for (const auto& frame : m_frames) {
+            values.push_back(frame.*field);
+        }
+
+        printPercentiles(out, name, std::move(values));
+    }
+
+    std::vector<Frame> m_frames;
+    double m_elapsedMs = 0.0;
+};
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// The widest kernel the compiler targets is used. AVX2 needs it enabled
+// explicitly, e.g. with -mavx2 or /arch:AVX2; SSE2 is part of x86-64.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)                                    \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_CULLER_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FRUSTUM_CULLER_NEON
+#endif
+
+#include "WorkerThreads.hpp"
+
+// Plane facing inwards: a point p is inside when dot(xyz, p) + w >= 0
+struct FrustumPlane {
+    float x, y, z, w;
+};
+
+using Frustum = std::array<FrustumPlane, 6>;
+
+// Bounding spheres stored as one array per component, so that the culling
+// kernels load the same component of several spheres at once
+struct BoundingSpheres {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    std::size_t size() const { return radius.size(); }
+
+    void resize(std::size_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        radius.resize(count);
+    }
+
+    void set(std::size_t index, float centerX, float centerY, float centerZ,
+        float sphereRadius)
+    {
+        x[index] = centerX;
+        y[index] = centerY;
+        z[index] = centerZ;
+        radius[index] = sphereRadius;
+    }
+};
+
+// Tests bounding spheres against a frustum and lists the visible ones.
+//
+// The spheres are split into contiguous ranges, one per thread, and each
+// range is culled into its own list so that threads never share output. The
+// calling thread culls the first range itself. Small inputs use fewer
+// threads, as waking them up costs more than the work.
+class FrustumCuller {
+public:
+    // Spheres tested per instruction
+#if defined(FRUSTUM_CULLER_AVX2)
+    static constexpr std::uint32_t width = 8;
+#elif defined(FRUSTUM_CULLER_SSE) || defined(FRUSTUM_CULLER_NEON)
+    static constexpr std::uint32_t width = 4;
+#else
+    static constexpr std::uint32_t width = 1;
+#endif
+
+    explicit FrustumCuller(
+        std::uint32_t threadCount = std::thread::hardware_concurrency())
+        : m_threads(threadCount)
+        , m_ranges(m_threads.threadCount())
+    {
+    }
+
+    std::uint32_t threadCount() const { return m_threads.threadCount(); }
+
+    static const char* kernel()
+    {
+#if defined(FRUSTUM_CULLER_AVX2)
+        return "avx2";
+#elif defined(FRUSTUM_CULLER_SSE)
+        return "sse2";
+#elif defined(FRUSTUM_CULLER_NEON)
+        return "neon";
+#else
+        return "scalar";
+#endif
+    }
+
+    // Returns the indices of the spheres that are inside or intersect the
+    // frustum, in increasing order. The list stays valid until the next
+    // call.
+    const std::vector<std::uint32_t>& cull(
+        const BoundingSpheres& spheres, const Frustum& frustum)
+    {
+        const auto count = static_cast<std::uint32_t>(spheres.size());
+        const auto rangeCount = std::max(
+            std::min(threadCount(), count / minRangeSize), 1u);
+
+        // Every range may be fully visible. Sizing the lists up front keeps
+        // allocations out of the worker threads.
+        for (std::uint32_t i = 0; i < rangeCount; i++) {
+            m_ranges[i].resize(rangeSize(count, rangeCount, i));
+        }
+
+        m_threads.run(rangeCount, [&](std::uint32_t range) {
+            auto& visible = m_ranges[range];
+
+            visible.resize(cullRange(spheres, frustum,
+                rangeFirst(count, rangeCount, range),
+                rangeSize(count, rangeCount, range), visible.data()));
+        });
+
+        m_visible.clear();
+        for (std::uint32_t i = 0; i < rangeCount; i++) {
+            m_visible.insert(
+                m_visible.end(), m_ranges[i].begin(), m_ranges[i].end());
+        }
+
+        return m_visible;
+    }
+
+    // Culls the spheres [first, first + count) on the calling thread into
+    // visible, which must have room for count indices. Returns the number
+    // of visible spheres.
+    static std::uint32_t cullRange(const BoundingSpheres& spheres,
+        const Frustum& frustum, std::uint32_t first, std::uint32_t count,
+        std::uint32_t* visible)
+    {
+        const auto last = first + count;
+        std::uint32_t visibleCount = 0;
+        std::uint32_t i = first;
+
+#if defined(FRUSTUM_CULLER_AVX2)
+        __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (std::size_t p = 0; p < frustum.size(); p++) {
+            planeX[p] = _mm256_set1_ps(frustum[p].x);
+            planeY[p] = _mm256_set1_ps(frustum[p].y);
+            planeZ[p] = _mm256_set1_ps(frustum[p].z);
+            planeW[p] = _mm256_set1_ps(frustum[p].w);
+        }
+
+        for (; i + width <= last; i += width) {
+            const auto x = _mm256_loadu_ps(&spheres.x[i]);
+            const auto y = _mm256_loadu_ps(&spheres.y[i]);
+            const auto z = _mm256_loadu_ps(&spheres.z[i]);
+            const auto negativeRadius = _mm256_sub_ps(
+                _mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+
+            auto outside = _mm256_setzero_ps();
+            for (std::size_t p = 0; p < frustum.size(); p++) {
+                const auto distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(planeX[p], x),
+                        _mm256_mul_ps(planeY[p], y)),
+                    _mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+                outside = _mm256_or_ps(outside,
+                    _mm256_cmp_ps(distance, negativeRadius, _CMP_LT_OQ));
+            }
+
+            visibleCount += compact(
+                ~_mm256_movemask_ps(outside), i, visible + visibleCount);
+        }
+#elif defined(FRUSTUM_CULLER_SSE)
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (std::size_t p = 0; p < frustum.size(); p++) {
+            planeX[p] = _mm_set1_ps(frustum[p].x);
+            planeY[p] = _mm_set1_ps(frustum[p].y);
+            planeZ[p] = _mm_set1_ps(frustum[p].z);
+            planeW[p] = _mm_set1_ps(frustum[p].w);
+        }
+
+        for (; i + width <= last; i += width) {
+            const auto x = _mm_loadu_ps(&spheres.x[i]);
+            const auto y = _mm_loadu_ps(&spheres.y[i]);
+            const auto z = _mm_loadu_ps(&spheres.z[i]);
+            const auto negativeRadius = _mm_sub_ps(
+                _mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+            auto outside = _mm_setzero_ps();
+            for (std::size_t p = 0; p < frustum.size(); p++) {
+                const auto distance = _mm_add_ps(
+                    _mm_add_ps(
+                        _mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                    _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+                outside = _mm_or_ps(
+                    outside, _mm_cmplt_ps(distance, negativeRadius));
+            }
+
+            visibleCount += compact(
+                ~_mm_movemask_ps(outside), i, visible + visibleCount);
+        }
+#elif defined(FRUSTUM_CULLER_NEON)
+        float32x4_t planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (std::size_t p = 0; p < frustum.size(); p++) {
+            planeX[p] = vdupq_n_f32(frustum[p].x);
+            planeY[p] = vdupq_n_f32(frustum[p].y);
+            planeZ[p] = vdupq_n_f32(frustum[p].z);
+            planeW[p] = vdupq_n_f32(frustum[p].w);
+        }
+
+        for (; i + width <= last; i += width) {
+            const auto x = vld1q_f32(&spheres.x[i]);
+            const auto y = vld1q_f32(&spheres.y[i]);
+            const auto z = vld1q_f32(&spheres.z[i]);
+            const auto negativeRadius
+                = vnegq_f32(vld1q_f32(&spheres.radius[i]));
+
+            auto outside = vdupq_n_u32(0);
+            for (std::size_t p = 0; p < frustum.size(); p++) {
+                auto distance = vmlaq_f32(planeW[p], planeX[p], x);
+                distance = vmlaq_f32(distance, planeY[p], y);
+                distance = vmlaq_f32(distance, planeZ[p], z);
+                outside
+                    = vorrq_u32(outside, vcltq_f32(distance, negativeRadius));
+            }
+
+            const int mask = (vgetq_lane_u32(outside, 0) & 1)
+                | (vgetq_lane_u32(outside, 1) & 2)
+                | (vgetq_lane_u32(outside, 2) & 4)
+                | (vgetq_lane_u32(outside, 3) & 8);
+
+            visibleCount += compact(~mask, i, visible + visibleCount);
+        }
+#endif
+
+        // The spheres left over from the last full vector
+        for (; i < last; i++) {
+            bool inside = true;
+
+            for (const auto& plane : frustum) {
+                const auto distance = plane.x * spheres.x[i]
+                    + plane.y * spheres.y[i] + plane.z * spheres.z[i]
+                    + plane.w;
+                inside = inside && distance >= -spheres.radius[i];
+            }
+
+            visible[visibleCount] = i;
+            visibleCount += inside ? 1 : 0;
+        }
+
+        return visibleCount;
+    }
+
+private:
+    // Fewer spheres than this per thread aren't worth a thread
+    static constexpr std::uint32_t minRangeSize = 16 * 1024;
+
+    // Ranges start at multiples of the kernel width, so that only the last
+    // range has a scalar remainder
+    static std::uint32_t rangeFirst(
+        std::uint32_t count, std::uint32_t rangeCount, std::uint32_t range)
+    {
+        if (range == rangeCount) {
+            return count;
+        }
+
+        const auto first = static_cast<std::uint32_t>(
+            std::uint64_t{ count } * range / rangeCount);
+        return first - first % width;
+    }
+
+    static std::uint32_t rangeSize(
+        std::uint32_t count, std::uint32_t rangeCount, std::uint32_t range)
+    {
+        return rangeFirst(count, rangeCount, range + 1)
+            - rangeFirst(count, rangeCount, range);
+    }
+
+    // Writes first + lane for each lane set in the low width bits of mask,
+    // without branching on the mask, and returns how many were written.
+    // visible must have room for width indices.
+    static std::uint32_t compact(
+        int mask, std::uint32_t first, std::uint32_t* visible)
+    {
+        std::uint32_t written = 0;
+
+        for (std::uint32_t lane = 0; lane < width; lane++) {
+            visible[written] = first + lane;
+            written += (mask >> lane) & 1;
+        }
+
+        return written;
+    }
+
+    WorkerThreads m_threads;
+
+    // Written by each thread at its own index
+    std::vector<std::vector<std::uint32_t>> m_ranges;
+    std::vector<std::uint32_t> m_visible;
+};
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Measures regions of command buffers with timestamp and pipeline statistics
+// queries.
+//
+// Each frame in flight has its own range of queries. Results are collected
+// once the frame's fence has signaled, when they are already available, so
+// reading them never stalls. Collected frames are kept in a bounded history
+// that can be exported as CSV or JSON.
+//
+// Pipeline statistics are only gathered when the device was created with the
+// pipelineStatisticsQuery and inheritedQueries features enabled, the latter
+// so that regions may execute secondary command buffers. Regions must not
+// nest, because only one pipeline statistics query may be active at a time.
+class GpuProfiler {
+public:
+    struct Region {
+        std::string name;
+        double gpuMs;
+        std::uint64_t vertexInvocations;
+        std::uint64_t clippingPrimitives;
+        std::uint64_t fragmentInvocations;
+    };
+
+    struct Frame {
+        std::uint64_t number;
+        std::vector<Region> regions;
+
+        double gpuMs() const
+        {
+            double sum = 0.0;
+            for (const auto& region : regions) {
+                sum += region.gpuMs;
+            }
+            return sum;
+        }
+    };
+
+    GpuProfiler(const vk::Device& device, const vk::PhysicalDevice& gpu,
+        std::uint32_t queueFamilyIndex, std::uint32_t framesInFlight,
+        std::uint32_t maxRegions = 8, std::size_t historySize = 1000)
+        : m_device(device)
+        , m_maxRegions(maxRegions)
+        , m_historySize(historySize)
+        , m_slots(framesInFlight)
+    {
+        const auto props = gpu.getProperties();
+        const auto queueFamilyProperties = gpu.getQueueFamilyProperties();
+
+        m_timestampPeriod = props.limits.timestampPeriod;
+        m_timestampValidBits
+            = queueFamilyProperties.at(queueFamilyIndex).timestampValidBits;
+        const auto features = gpu.getFeatures();
+        m_statistics = features.pipelineStatisticsQuery == VK_TRUE
+            && features.inheritedQueries == VK_TRUE;
+
+        if (timestamps()) {
+            // One timestamp on each side of every region
+            m_timestampPool = m_device.createQueryPool(
+                { {}, vk::QueryType::eTimestamp,
+                    framesInFlight * m_maxRegions * 2, {} });
+        }
+
+        if (m_statistics) {
+            m_statisticsPool = m_device.createQueryPool(
+                { {}, vk::QueryType::ePipelineStatistics,
+                    framesInFlight * m_maxRegions, statisticFlags() });
+        }
+    }
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    ~GpuProfiler()
+    {
+        if (m_timestampPool) {
+            m_device.destroyQueryPool(m_timestampPool);
+        }
+
+        if (m_statisticsPool) {
+            m_device.destroyQueryPool(m_statisticsPool);
+        }
+    }
+
+    bool timestamps() const { return m_timestampValidBits != 0; }
+    bool statistics() const { return m_statistics; }
+
+    // Statistics that secondary command buffers executed within a region
+    // must declare in their inheritance info
+    vk::QueryPipelineStatisticFlags inheritedStatistics() const
+    {
+        return m_statistics ? statisticFlags()
+                            : vk::QueryPipelineStatisticFlags{};
+    }
+
+    // Resets the queries of the frame. Must be recorded outside of a render
+    // pass, before any region of the frame.
+    void beginFrame(const vk::CommandBuffer& commandBuffer,
+        std::uint32_t frameIndex)
+    {
+        m_current = frameIndex;
+
+        auto& slot = m_slots.at(m_current);
+        slot.number = m_frameCount++;
+        slot.names.clear();
+        slot.open = false;
+
+        if (m_timestampPool) {
+            commandBuffer.resetQueryPool(m_timestampPool,
+                m_current * m_maxRegions * 2, m_maxRegions * 2);
+        }
+
+        if (m_statisticsPool) {
+            commandBuffer.resetQueryPool(
+                m_statisticsPool, m_current * m_maxRegions, m_maxRegions);
+        }
+    }
+
+    // Starts a region of the current frame and returns the index to end it
+    // with
+    std::uint32_t beginRegion(
+        const vk::CommandBuffer& commandBuffer, const char* name)
+    {
+        auto& slot = m_slots.at(m_current);
+
+        if (slot.open) {
+            throw std::logic_error("GPU profiler regions must not nest");
+        }
+
+        if (slot.names.size() == m_maxRegions) {
+            throw std::runtime_error("Too many GPU profiler regions");
+        }
+
+        const auto region = static_cast<std::uint32_t>(slot.names.size());
+        slot.names.emplace_back(name);
+        slot.open = true;
+
+        if (m_timestampPool) {
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                m_timestampPool, timestampQuery(region));
+        }
+
+        if (m_statisticsPool) {
+            commandBuffer.beginQuery(
+                m_statisticsPool, statisticsQuery(region), {});
+        }
+
+        return region;
+    }
+
+    void endRegion(const vk::CommandBuffer& commandBuffer, std::uint32_t region)
+    {
+        if (m_statisticsPool) {
+            commandBuffer.endQuery(m_statisticsPool, statisticsQuery(region));
+        }
+
+        if (m_timestampPool) {
+            commandBuffer.writeTimestamp(
+                vk::PipelineStageFlagBits::eBottomOfPipe, m_timestampPool,
+                timestampQuery(region) + 1);
+        }
+
+        m_slots.at(m_current).open = false;
+    }
+
+    // Reads the results of the frame last recorded in the given slot, which
+    // must have completed, and appends them to the history. Returns nullptr
+    // when the slot holds no frame or its results are not available yet.
+    const Frame* collect(std::uint32_t frameIndex)
+    {
+        auto& slot = m_slots.at(frameIndex);
+
+        if (slot.names.empty()) {
+            return nullptr;
+        }
+
+        const auto regionCount = static_cast<std::uint32_t>(slot.names.size());
+        const auto base = frameIndex * m_maxRegions;
+
+        std::vector<std::uint64_t> timestamps(regionCount * 2);
+        if (m_timestampPool) {
+            const auto result = m_device.getQueryPoolResults(m_timestampPool,
+                base * 2, regionCount * 2,
+                timestamps.size() * sizeof(std::uint64_t), timestamps.data(),
+                sizeof(std::uint64_t), vk::QueryResultFlagBits::e64);
+
+            if (result != vk::Result::eSuccess) {
+                return nullptr;
+            }
+        }
+
+        std::vector<std::array<std::uint64_t, statisticCount>> statistics(
+            regionCount);
+        if (m_statisticsPool) {
+            const auto result = m_device.getQueryPoolResults(m_statisticsPool,
+                base, regionCount,
+                statistics.size() * sizeof(statistics.front()),
+                statistics.data(), sizeof(statistics.front()),
+                vk::QueryResultFlagBits::e64);
+
+            if (result != vk::Result::eSuccess) {
+                return nullptr;
+            }
+        }
+
+        const std::uint64_t mask = m_timestampValidBits >= 64
+            ? ~std::uint64_t{ 0 }
+            : (std::uint64_t{ 1 } << m_timestampValidBits) - 1;
+
+        Frame frame{ slot.number, {} };
+
+        for (std::uint32_t i = 0; i < regionCount; i++) {
+            const auto ticks = (timestamps.at(i * 2 + 1) - timestamps.at(i * 2))
+                & mask;
+
+            // Results come in the order of the statistic flag bits
+            frame.regions.push_back({ slot.names.at(i),
+                static_cast<double>(ticks) * m_timestampPeriod / 1'000'000.0,
+                statistics.at(i).at(0), statistics.at(i).at(1),
+                statistics.at(i).at(2) });
+        }
+
+        slot.names.clear();
+
+        m_history.push_back(std::move(frame));
+        if (m_history.size() > m_historySize) {
+            m_history.pop_front();
+        }
+
+        return &m_history.back();
+    }
+
+    // Writes the history with one row per region. Fields that were not
+    // measured are left empty.
+    void writeCsv(std::FILE* out) const
+    {
+        std::fprintf(out,
+            "frame,region,gpu_ms,vertex_invocations,clipping_primitives,"
+            "fragment_invocations\n");
+
+        for (const auto& frame : m_history) {
+            for (const auto& region : frame.regions) {
+                std::fprintf(out, "%llu,%s,",
+                    static_cast<unsigned long long>(frame.number),
+                    region.name.c_str());
+
+                if (timestamps()) {
+                    std::fprintf(out, "%.4f", region.gpuMs);
+                }
+
+                if (m_statistics) {
+                    std::fprintf(out, ",%llu,%llu,%llu\n",
+                        static_cast<unsigned long long>(
+                            region.vertexInvocations),
+                        static_cast<unsigned long long>(
+                            region.clippingPrimitives),
+                        static_cast<unsigned long long>(
+                            region.fragmentInvocations));
+                } else {
+                    std::fprintf(out, ",,,\n");
+                }
+            }
+        }
+    }
+
+    // Writes the history as an array of frames. Fields that were not
+    // measured are null.
+    void writeJson(std::FILE* out) const
+    {
+        std::fprintf(out, "{\"frames\":[");
+
+        for (std::size_t i = 0; i < m_history.size(); i++) {
+            const auto& frame = m_history[i];
+
+            std::fprintf(out, "%s\n{\"frame\":%llu,\"regions\":[",
+                i == 0 ? "" : ",",
+                static_cast<unsigned long long>(frame.number));
+
+            for (std::size_t j = 0; j < frame.regions.size(); j++) {
+                const auto& region = frame.regions[j];
+
+                // Region names are identifiers chosen by the caller and
+                // need no escaping
+                std::fprintf(out, "%s{\"name\":\"%s\",\"gpu_ms\":",
+                    j == 0 ? "" : ",", region.name.c_str());
+
+                if (timestamps()) {
+                    std::fprintf(out, "%.4f", region.gpuMs);
+                } else {
+                    std::fprintf(out, "null");
+                }
+
+                if (m_statistics) {
+                    std::fprintf(out,
+                        ",\"vertex_invocations\":%llu"
+                        ",\"clipping_primitives\":%llu"
+                        ",\"fragment_invocations\":%llu}",
+                        static_cast<unsigned long long>(
+                            region.vertexInvocations),
+                        static_cast<unsigned long long>(
+                            region.clippingPrimitives),
+                        static_cast<unsigned long long>(
+                            region.fragmentInvocations));
+                } else {
+                    std::fprintf(out,
+                        ",\"vertex_invocations\":null"
+                        ",\"clipping_primitives\":null"
+                        ",\"fragment_invocations\":null}");
+                }
+            }
+
+            std::fprintf(out, "]}");
+        }
+
+        std::fprintf(out, "\n]}\n");
+    }
+
+private:
+    static constexpr std::size_t statisticCount = 3;
+
+    struct Slot {
+        std::uint64_t number = 0;
+        std::vector<std::string> names;
+        bool open = false;
+    };
+
+    static vk::QueryPipelineStatisticFlags statisticFlags()
+    {
+        return vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations
+            | vk::QueryPipelineStatisticFlagBits::eClippingPrimitives
+            | vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+    }
+
+    std::uint32_t timestampQuery(std::uint32_t region) const
+    {
+        return (m_current * m_maxRegions + region) * 2;
+    }
+
+    std::uint32_t statisticsQuery(std::uint32_t region) const
+    {
+        return m_current * m_maxRegions + region;
+    }
+
+    vk::Device m_device;
+    std::uint32_t m_maxRegions;
+    std::size_t m_historySize;
+
+    float m_timestampPeriod = 0.0f;
+    std::uint32_t m_timestampValidBits = 0;
+    bool m_statistics = false;
+    vk::QueryPool m_timestampPool;
+    vk::QueryPool m_statisticsPool;
+
+    std::vector<Slot> m_slots;
+    std::uint32_t m_current = 0;
+    std::uint64_t m_frameCount = 0;
+    std::deque<Frame> m_history;
+};
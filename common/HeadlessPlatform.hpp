@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameLimiter.hpp"
+#include "PlatformConfig.hpp"
+
+// A platform without a window or a surface, for rendering offscreen. It
+// builds on any system with a Vulkan loader.
+class HeadlessPlatform {
+public:
+    explicit HeadlessPlatform(const PlatformConfig& config)
+        : m_config(config)
+    {
+    }
+
+    static std::vector<const char*> instanceExtensions() { return {}; }
+
+    vk::Extent2D extent() const
+    {
+        return { m_config.width, m_config.height };
+    }
+
+    // There is no window to show a title in
+    void setTitle(const std::string&) {}
+
+    void requestRedraw() {}
+
+    // Calls frame until it returns false. Nothing generates events here, so
+    // LoopMode::eOnDemand behaves like LoopMode::eContinuous.
+    int run(const std::function<bool()>& frame)
+    {
+        FrameLimiter limiter(m_config.loopMode == LoopMode::eLimited
+                ? m_config.maxFrameRate
+                : 0.0);
+
+        while (true) {
+            std::this_thread::sleep_until(limiter.deadline());
+            limiter.advance();
+
+            if (!frame()) {
+                return 0;
+            }
+        }
+    }
+
+private:
+    PlatformConfig m_config;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "FrameStats.hpp"
+
+// Collects when each frame reached the stages between the start of its
+// simulation and the GPU finishing it, and prints them as CSV followed by a
+// summary.
+//
+// Times are in milliseconds since the simulation step of the latest state a
+// frame shows was due, so they include the time that state waited to be
+// rendered. Completion is when the CPU first saw the frame's fence signaled,
+// so it is an upper bound, late by at most one turn of the frame loop. What
+// the display adds after that isn't visible without display timing
+// extensions.
+class LatencyStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame {
+        // When the simulation step of the latest state shown was due
+        Clock::time_point simulation;
+        Clock::time_point submit;
+        Clock::time_point present;
+        Clock::time_point complete;
+    };
+
+    void add(const Frame& frame)
+    {
+        m_frames.push_back({ sinceSimulation(frame, frame.submit),
+            sinceSimulation(frame, frame.present),
+            sinceSimulation(frame, frame.complete) });
+    }
+
+    std::size_t size() const { return m_frames.size(); }
+
+    // Mean simulation-to-completion time of the frames added since the
+    // given number of frames, e.g. for a periodic report
+    double meanCompleteMs(std::size_t since) const
+    {
+        if (since >= m_frames.size()) {
+            return 0.0;
+        }
+
+        double sum = 0.0;
+        for (auto i = since; i < m_frames.size(); i++) {
+            sum += m_frames[i].completeMs;
+        }
+
+        return sum / (m_frames.size() - since);
+    }
+
+    void print(std::FILE* out) const
+    {
+        std::fprintf(out, "frame,submit_ms,present_ms,complete_ms\n");
+
+        for (std::size_t i = 0; i < m_frames.size(); i++) {
+            std::fprintf(out, "%zu,%.4f,%.4f,%.4f\n", i, m_frames[i].submitMs,
+                m_frames[i].presentMs, m_frames[i].completeMs);
+        }
+
+        printSummary(out, "submit_ms", &Latency::submitMs);
+        printSummary(out, "present_ms", &Latency::presentMs);
+        printSummary(out, "complete_ms", &Latency::completeMs);
+    }
+
+private:
+    struct Latency {
+        double submitMs;
+        double presentMs;
+        double completeMs;
+    };
+
+    static double sinceSimulation(
+        const Frame& frame, const Clock::time_point& time)
+    {
+        const std::chrono::duration<double, std::milli> elapsed
+            = time - frame.simulation;
+
+        return elapsed.count();
+    }
+
+    void printSummary(
+        std::FILE* out, const char* name, double Latency::*field) const
+    {
+        std::vector<double> values;
+        values.reserve(m_frames.size());
+
+        for (const auto& frame : m_frames) {
+            values.push_back(frame.*field);
+        }
+
+        printPercentiles(out, name, std::move(values));
+    }
+
+    std::vector<Latency> m_frames;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace Log {
+
+// Writes a printf-style message to stderr, and to the debugger output on
+// Windows where GUI applications have no console
+static inline void print(const char* format, ...)
+{
+    char message[1024];
+
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    std::fputs(message, stderr);
+
+#if defined(_WIN32)
+    OutputDebugStringA(message);
+#endif
+}
+
+} // namespace Log
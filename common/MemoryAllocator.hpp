@@ -0,0 +1,360 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// Sub-allocates resources from large device memory blocks.
+//
+// Resources go through a best-fit free list per memory type, with freed
+// ranges coalesced back into their neighbours. Per-frame transient data is
+// written into rings within a single allocation instead, see StreamBuffer
+// and Uploader. Buffers and optimally tiled images never share a block, so
+// bufferImageGranularity needs no padding.
+//
+// Allocating and freeing may happen on several threads at once.
+class MemoryAllocator {
+public:
+    struct Allocation {
+        vk::DeviceMemory memory;
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size = 0;
+        // Points at offset when the memory is host visible
+        char* mapped = nullptr;
+
+        std::uint32_t pool = 0;
+        std::uint32_t block = 0;
+    };
+
+    struct Stats {
+        std::uint32_t blockCount = 0;
+        std::uint32_t allocationCount = 0;
+        vk::DeviceSize blockBytes = 0;
+        vk::DeviceSize usedBytes = 0;
+        vk::DeviceSize freeBytes = 0;
+        vk::DeviceSize largestFreeRange = 0;
+        std::uint32_t freeRangeCount = 0;
+
+        // 0 when all free memory is one contiguous range, approaching 1 as
+        // it is scattered over many small ranges
+        double fragmentation() const
+        {
+            return freeBytes == 0
+                ? 0.0
+                : 1.0 - static_cast<double>(largestFreeRange) / freeBytes;
+        }
+    };
+
+    MemoryAllocator(const vk::Device& device, const vk::PhysicalDevice& gpu,
+        vk::DeviceSize blockSize = 64 * 1024 * 1024)
+        : m_device(device)
+        , m_memoryProps(gpu.getMemoryProperties())
+        , m_maxAllocationCount(
+              gpu.getProperties().limits.maxMemoryAllocationCount)
+        , m_blockSize(blockSize)
+        , m_pools(m_memoryProps.memoryTypeCount * 2)
+    {
+    }
+
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    ~MemoryAllocator()
+    {
+        for (const auto& pool : m_pools) {
+            for (const auto& block : pool) {
+                releaseBlock(block);
+            }
+        }
+    }
+
+    // Returns the first memory type allowed by typeBits that has all the
+    // given property flags
+    static std::uint32_t findMemoryTypeIndex(
+        const vk::PhysicalDeviceMemoryProperties& memoryProps,
+        std::uint32_t typeBits, const vk::MemoryPropertyFlags& propertyFlags)
+    {
+        for (std::uint32_t i = 0; i < memoryProps.memoryTypeCount; i++) {
+            if ((typeBits & (1u << i))
+                && (memoryProps.memoryTypes[i].propertyFlags & propertyFlags)
+                    == propertyFlags) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("No appropriate memory type");
+    }
+
+    const vk::PhysicalDeviceMemoryProperties& memoryProperties() const
+    {
+        return m_memoryProps;
+    }
+
+    Allocation allocate(const vk::MemoryRequirements& requirements,
+        const vk::MemoryPropertyFlags& propertyFlags, bool optimalImage = false)
+    {
+        const auto memoryTypeIndex = findMemoryTypeIndex(
+            m_memoryProps, requirements.memoryTypeBits, propertyFlags);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return allocateFreeList(
+            memoryTypeIndex * 2 + (optimalImage ? 1 : 0), requirements);
+    }
+
+    Allocation allocateBuffer(
+        const vk::Buffer& buffer, const vk::MemoryPropertyFlags& propertyFlags)
+    {
+        const auto allocation = allocate(
+            m_device.getBufferMemoryRequirements(buffer), propertyFlags);
+        m_device.bindBufferMemory(buffer, allocation.memory, allocation.offset);
+
+        return allocation;
+    }
+
+    // Assumes the image uses optimal tiling
+    Allocation allocateImage(
+        const vk::Image& image, const vk::MemoryPropertyFlags& propertyFlags)
+    {
+        const auto allocation = allocate(
+            m_device.getImageMemoryRequirements(image), propertyFlags, true);
+        m_device.bindImageMemory(image, allocation.memory, allocation.offset);
+
+        return allocation;
+    }
+
+    void free(const Allocation& allocation)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        freeFreeList(allocation);
+    }
+
+    Stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Stats stats;
+
+        const auto addBlock = [&stats](const Block& block) {
+            if (!block.memory) {
+                return;
+            }
+
+            stats.blockCount++;
+            stats.allocationCount += block.allocationCount;
+            stats.blockBytes += block.size;
+
+            for (const auto& range : block.freeRanges) {
+                stats.freeBytes += range.second;
+                stats.largestFreeRange
+                    = std::max(stats.largestFreeRange, range.second);
+                stats.freeRangeCount++;
+            }
+        };
+
+        for (const auto& pool : m_pools) {
+            std::for_each(pool.cbegin(), pool.cend(), addBlock);
+        }
+
+        stats.usedBytes = stats.blockBytes - stats.freeBytes;
+
+        return stats;
+    }
+
+    void printStats(std::FILE* out) const
+    {
+        const auto s = stats();
+
+        std::fprintf(out,
+            "# memory blocks=%u allocations=%u block_bytes=%llu "
+            "used_bytes=%llu free_ranges=%u largest_free=%llu "
+            "fragmentation=%.4f\n",
+            s.blockCount, s.allocationCount,
+            static_cast<unsigned long long>(s.blockBytes),
+            static_cast<unsigned long long>(s.usedBytes), s.freeRangeCount,
+            static_cast<unsigned long long>(s.largestFreeRange),
+            s.fragmentation());
+    }
+
+private:
+    struct Block {
+        vk::DeviceMemory memory;
+        vk::DeviceSize size = 0;
+        char* mapped = nullptr;
+        std::uint32_t allocationCount = 0;
+        // Offset to size of each free range, kept coalesced
+        std::map<vk::DeviceSize, vk::DeviceSize> freeRanges;
+    };
+
+    static vk::DeviceSize alignUp(vk::DeviceSize offset, vk::DeviceSize alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    Block createBlock(std::uint32_t memoryTypeIndex, vk::DeviceSize size)
+    {
+        if (m_allocationCount >= m_maxAllocationCount) {
+            throw std::runtime_error("Too many device memory allocations");
+        }
+
+        Block block;
+        block.memory = m_device.allocateMemory({ size, memoryTypeIndex });
+        block.size = size;
+        block.freeRanges.emplace(0, size);
+        m_allocationCount++;
+
+        if (m_memoryProps.memoryTypes[memoryTypeIndex].propertyFlags
+            & vk::MemoryPropertyFlagBits::eHostVisible) {
+            block.mapped = static_cast<char*>(
+                m_device.mapMemory(block.memory, 0, VK_WHOLE_SIZE, {}));
+        }
+
+        return block;
+    }
+
+    void releaseBlock(const Block& block)
+    {
+        if (!block.memory) {
+            return;
+        }
+
+        if (block.mapped) {
+            m_device.unmapMemory(block.memory);
+        }
+
+        m_device.freeMemory(block.memory);
+        m_allocationCount--;
+    }
+
+    Allocation allocateFreeList(
+        std::uint32_t poolIndex, const vk::MemoryRequirements& requirements)
+    {
+        auto& pool = m_pools.at(poolIndex);
+
+        const auto suballocate = [&](std::uint32_t blockIndex) {
+            auto& block = pool.at(blockIndex);
+
+            // Best fit: the smallest free range the aligned request fits in
+            auto best = block.freeRanges.end();
+            for (auto it = block.freeRanges.begin();
+                 it != block.freeRanges.end(); ++it) {
+                const auto offset = alignUp(it->first, requirements.alignment);
+
+                if (offset + requirements.size <= it->first + it->second
+                    && (best == block.freeRanges.end()
+                           || it->second < best->second)) {
+                    best = it;
+                }
+            }
+
+            if (best == block.freeRanges.end()) {
+                return false;
+            }
+
+            const auto rangeBegin = best->first;
+            const auto rangeEnd = best->first + best->second;
+            const auto offset = alignUp(rangeBegin, requirements.alignment);
+
+            block.freeRanges.erase(best);
+
+            if (offset > rangeBegin) {
+                block.freeRanges.emplace(rangeBegin, offset - rangeBegin);
+            }
+
+            if (offset + requirements.size < rangeEnd) {
+                block.freeRanges.emplace(offset + requirements.size,
+                    rangeEnd - offset - requirements.size);
+            }
+
+            block.allocationCount++;
+
+            m_lastAllocation = Allocation{ block.memory, offset,
+                requirements.size,
+                block.mapped ? block.mapped + offset : nullptr, poolIndex,
+                blockIndex };
+
+            return true;
+        };
+
+        for (std::uint32_t i = 0; i < pool.size(); i++) {
+            if (pool.at(i).memory && suballocate(i)) {
+                return m_lastAllocation;
+            }
+        }
+
+        // Reuse the slot of a released block so that block indices held by
+        // live allocations stay valid
+        const auto slot = std::distance(pool.begin(),
+            std::find_if(pool.begin(), pool.end(),
+                [](const auto& block) { return !block.memory; }));
+
+        if (slot == static_cast<std::ptrdiff_t>(pool.size())) {
+            pool.emplace_back();
+        }
+
+        // Requests larger than a block get a block of their own
+        pool.at(slot) = createBlock(
+            poolIndex / 2, std::max(m_blockSize, requirements.size));
+
+        suballocate(static_cast<std::uint32_t>(slot));
+
+        return m_lastAllocation;
+    }
+
+    void freeFreeList(const Allocation& allocation)
+    {
+        auto& pool = m_pools.at(allocation.pool);
+        auto& block = pool.at(allocation.block);
+
+        auto begin = allocation.offset;
+        auto end = allocation.offset + allocation.size;
+
+        // Coalesce with the following and the preceding free range
+        const auto next = block.freeRanges.find(end);
+        if (next != block.freeRanges.end()) {
+            end += next->second;
+            block.freeRanges.erase(next);
+        }
+
+        const auto after = block.freeRanges.lower_bound(begin);
+        if (after != block.freeRanges.begin()) {
+            const auto prev = std::prev(after);
+
+            if (prev->first + prev->second == begin) {
+                begin = prev->first;
+                block.freeRanges.erase(prev);
+            }
+        }
+
+        block.freeRanges.emplace(begin, end - begin);
+        block.allocationCount--;
+
+        // Give empty blocks back to the driver, but keep the first one around
+        // to avoid churn when a single resource is recreated
+        if (block.allocationCount == 0 && allocation.block != 0) {
+            releaseBlock(block);
+            block = Block{};
+        }
+    }
+
+    vk::Device m_device;
+    vk::PhysicalDeviceMemoryProperties m_memoryProps;
+    std::uint32_t m_maxAllocationCount;
+    vk::DeviceSize m_blockSize;
+    std::uint32_t m_allocationCount = 0;
+
+    // Indexed by memory type index * 2, plus one for optimal images
+    std::vector<std::vector<Block>> m_pools;
+
+    Allocation m_lastAllocation;
+
+    mutable std::mutex m_mutex;
+};
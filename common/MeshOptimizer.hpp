@@ -0,0 +1,391 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+// Offline passes that reorder indexed triangle lists for the GPU, to run once
+// when a mesh is built rather than every time it is loaded:
+//
+//  1. optimizeVertexCache() orders triangles so that consecutive triangles
+//     share vertices, which the post-transform cache then shades once.
+//  2. optimizeOverdraw() reorders clusters of those triangles so that the
+//     ones facing outwards come first and occlude the rest, without losing
+//     much of the cache efficiency.
+//  3. optimizeVertexFetch() orders the vertices by first use, so that
+//     fetching them reads memory mostly sequentially.
+//
+// The cache is modeled as a FIFO of cacheSize vertices, a conservative fit
+// for current GPUs.
+namespace MeshOptimizer {
+
+struct CacheStatistics {
+    // Vertices shaded per triangle, from 0.5 for an ideal grid to 3
+    double acmr;
+    // Vertices shaded per vertex of the mesh, at best 1
+    double atvr;
+};
+
+namespace Detail {
+
+// A FIFO cache of vertices, simulated with one timestamp per vertex
+class CacheSimulator {
+public:
+    CacheSimulator(std::size_t vertexCount, std::uint32_t cacheSize)
+        : m_cacheSize(cacheSize)
+        , m_time(cacheSize + 1)
+        , m_times(vertexCount, 0)
+    {
+    }
+
+    // Returns true on a miss
+    bool access(std::uint32_t vertex)
+    {
+        if (m_time - m_times[vertex] <= m_cacheSize) {
+            return false;
+        }
+
+        m_times[vertex] = m_time++;
+        return true;
+    }
+
+    void flush() { m_time += m_cacheSize + 1; }
+
+private:
+    std::uint32_t m_cacheSize;
+    std::uint32_t m_time;
+    std::vector<std::uint32_t> m_times;
+};
+
+} // namespace Detail
+
+inline CacheStatistics analyzeVertexCache(
+    const std::vector<std::uint32_t>& indices, std::size_t vertexCount,
+    std::uint32_t cacheSize = 16)
+{
+    Detail::CacheSimulator cache(vertexCount, cacheSize);
+    std::size_t misses = 0;
+
+    for (const auto index : indices) {
+        misses += cache.access(index) ? 1 : 0;
+    }
+
+    const auto triangleCount = indices.size() / 3;
+
+    return { triangleCount > 0 ? static_cast<double>(misses) / triangleCount
+                               : 0.0,
+        vertexCount > 0 ? static_cast<double>(misses) / vertexCount : 0.0 };
+}
+
+// Reorders the triangles with Tipsify (Sander et al., "Fast Triangle
+// Reordering for Vertex Locality and Reduced Overdraw"), which fans around
+// one vertex at a time and picks the next one among the vertices just used.
+// It runs in linear time.
+inline std::vector<std::uint32_t> optimizeVertexCache(
+    const std::vector<std::uint32_t>& indices, std::size_t vertexCount,
+    std::uint32_t cacheSize = 16)
+{
+    const auto triangleCount = indices.size() / 3;
+    const auto noVertex = std::numeric_limits<std::size_t>::max();
+
+    // Triangles of each vertex, and how many of them are not emitted yet
+    std::vector<std::uint32_t> liveCounts(vertexCount, 0);
+    for (const auto index : indices) {
+        liveCounts[index]++;
+    }
+
+    std::vector<std::size_t> offsets(vertexCount + 1, 0);
+    std::partial_sum(
+        liveCounts.begin(), liveCounts.end(), offsets.begin() + 1);
+
+    std::vector<std::uint32_t> adjacency(indices.size());
+    {
+        auto cursors = offsets;
+        for (std::size_t i = 0; i < indices.size(); i++) {
+            adjacency[cursors[indices[i]]++]
+                = static_cast<std::uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<std::uint32_t> cacheTimes(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<std::uint32_t> deadEnds;
+    std::vector<std::uint32_t> candidates;
+    std::uint32_t time = cacheSize + 1;
+    std::size_t scanCursor = 0;
+
+    std::vector<std::uint32_t> output;
+    output.reserve(triangleCount * 3);
+
+    auto fanning = vertexCount > 0 ? 0 : noVertex;
+
+    while (fanning != noVertex) {
+        candidates.clear();
+
+        for (auto i = offsets[fanning]; i < offsets[fanning + 1]; i++) {
+            const auto triangle = adjacency[i];
+
+            if (emitted[triangle]) {
+                continue;
+            }
+
+            for (std::size_t corner = 0; corner < 3; corner++) {
+                const auto vertex = indices[triangle * 3 + corner];
+
+                output.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveCounts[vertex]--;
+
+                if (time - cacheTimes[vertex] > cacheSize) {
+                    cacheTimes[vertex] = time++;
+                }
+            }
+
+            emitted[triangle] = true;
+        }
+
+        // Prefer the candidate that entered the cache earliest among those
+        // that stay in it while their remaining triangles are emitted
+        fanning = noVertex;
+        std::int64_t bestPriority = -1;
+
+        for (const auto vertex : candidates) {
+            if (liveCounts[vertex] == 0) {
+                continue;
+            }
+
+            const std::int64_t age = time - cacheTimes[vertex];
+            const auto priority
+                = age + 2 * liveCounts[vertex] <= cacheSize ? age : 0;
+
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanning = vertex;
+            }
+        }
+
+        // A dead end: go back to a recently used vertex with triangles left,
+        // or else to the next one in input order
+        while (fanning == noVertex && !deadEnds.empty()) {
+            const auto vertex = deadEnds.back();
+            deadEnds.pop_back();
+
+            if (liveCounts[vertex] > 0) {
+                fanning = vertex;
+            }
+        }
+
+        while (fanning == noVertex && scanCursor < vertexCount) {
+            if (liveCounts[scanCursor] > 0) {
+                fanning = scanCursor;
+            }
+
+            scanCursor++;
+        }
+    }
+
+    return output;
+}
+
+// Splits cache-optimized triangles into clusters and sorts the clusters so
+// that those on the outside of the mesh, facing away from its center, are
+// drawn first. positions points at the x, y and z floats of the first
+// vertex, positionStride bytes apart.
+//
+// Clusters end where the cache was flushed anyway, and also where the
+// cluster's cache miss ratio so far is within threshold of the whole
+// cluster's, so threshold trades cache efficiency for finer sorting.
+inline void optimizeOverdraw(std::vector<std::uint32_t>& indices,
+    const float* positions, std::size_t positionStride,
+    std::size_t vertexCount, float threshold = 1.05f,
+    std::uint32_t cacheSize = 16)
+{
+    const auto triangleCount = indices.size() / 3;
+
+    if (triangleCount == 0) {
+        return;
+    }
+
+    const auto position = [&](std::uint32_t vertex) {
+        return reinterpret_cast<const float*>(
+            reinterpret_cast<const char*>(positions)
+            + vertex * positionStride);
+    };
+
+    const auto triangleMisses
+        = [&](Detail::CacheSimulator& cache, std::size_t triangle) {
+        std::uint32_t misses = 0;
+        for (std::size_t corner = 0; corner < 3; corner++) {
+            misses += cache.access(indices[triangle * 3 + corner]) ? 1 : 0;
+        }
+        return misses;
+    };
+
+    // Hard boundaries: triangles whose vertices all missed the cache
+    std::vector<std::size_t> hardBoundaries;
+    {
+        Detail::CacheSimulator cache(vertexCount, cacheSize);
+
+        for (std::size_t triangle = 0; triangle < triangleCount; triangle++) {
+            if (triangleMisses(cache, triangle) == 3 || triangle == 0) {
+                hardBoundaries.push_back(triangle);
+            }
+        }
+
+        hardBoundaries.push_back(triangleCount);
+    }
+
+    std::vector<std::size_t> clusterBegins;
+    {
+        Detail::CacheSimulator cache(vertexCount, cacheSize);
+
+        for (std::size_t i = 0; i + 1 < hardBoundaries.size(); i++) {
+            const auto begin = hardBoundaries[i];
+            const auto end = hardBoundaries[i + 1];
+
+            cache.flush();
+            std::size_t clusterMisses = 0;
+            for (auto triangle = begin; triangle < end; triangle++) {
+                clusterMisses += triangleMisses(cache, triangle);
+            }
+
+            const auto maximumRatio
+                = threshold * clusterMisses / static_cast<double>(end - begin);
+
+            cache.flush();
+            clusterBegins.push_back(begin);
+
+            auto softBegin = begin;
+            std::size_t misses = 0;
+
+            for (auto triangle = begin; triangle < end; triangle++) {
+                misses += triangleMisses(cache, triangle);
+
+                const auto ratio = static_cast<double>(misses)
+                    / (triangle - softBegin + 1);
+
+                if (triangle + 1 < end && ratio <= maximumRatio) {
+                    clusterBegins.push_back(triangle + 1);
+                    softBegin = triangle + 1;
+                    misses = 0;
+                    cache.flush();
+                }
+            }
+        }
+
+        clusterBegins.push_back(triangleCount);
+    }
+
+    const auto clusterCount = clusterBegins.size() - 1;
+
+    // Area weighted centroids and normals of the clusters and of the mesh
+    std::vector<float> centroids(clusterCount * 3, 0.0f);
+    std::vector<float> normals(clusterCount * 3, 0.0f);
+    double meshArea = 0.0;
+    double meshCentroid[3] = {};
+
+    for (std::size_t cluster = 0; cluster < clusterCount; cluster++) {
+        double area = 0.0;
+        double centroid[3] = {};
+        double normal[3] = {};
+
+        for (auto triangle = clusterBegins[cluster];
+             triangle < clusterBegins[cluster + 1]; triangle++) {
+            const auto a = position(indices[triangle * 3]);
+            const auto b = position(indices[triangle * 3 + 1]);
+            const auto c = position(indices[triangle * 3 + 2]);
+
+            const double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const double ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            const double cross[3] = { ab[1] * ac[2] - ab[2] * ac[1],
+                ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+
+            const auto triangleArea = std::sqrt(cross[0] * cross[0]
+                + cross[1] * cross[1] + cross[2] * cross[2]);
+
+            for (std::size_t axis = 0; axis < 3; axis++) {
+                centroid[axis]
+                    += (a[axis] + b[axis] + c[axis]) / 3.0 * triangleArea;
+                normal[axis] += cross[axis];
+            }
+
+            area += triangleArea;
+        }
+
+        const auto normalLength = std::sqrt(normal[0] * normal[0]
+            + normal[1] * normal[1] + normal[2] * normal[2]);
+
+        for (std::size_t axis = 0; axis < 3; axis++) {
+            meshCentroid[axis] += centroid[axis];
+            centroids[cluster * 3 + axis] = static_cast<float>(
+                area > 0.0 ? centroid[axis] / area : 0.0);
+            normals[cluster * 3 + axis] = static_cast<float>(
+                normalLength > 0.0 ? normal[axis] / normalLength : 0.0);
+        }
+
+        meshArea += area;
+    }
+
+    for (auto& axis : meshCentroid) {
+        axis = meshArea > 0.0 ? axis / meshArea : 0.0;
+    }
+
+    std::vector<float> keys(clusterCount);
+    for (std::size_t cluster = 0; cluster < clusterCount; cluster++) {
+        keys[cluster] = 0.0f;
+        for (std::size_t axis = 0; axis < 3; axis++) {
+            keys[cluster] += static_cast<float>(
+                (centroids[cluster * 3 + axis] - meshCentroid[axis])
+                * normals[cluster * 3 + axis]);
+        }
+    }
+
+    std::vector<std::size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+        [&](std::size_t a, std::size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<std::uint32_t> sorted;
+    sorted.reserve(indices.size());
+
+    for (const auto cluster : order) {
+        sorted.insert(sorted.end(),
+            indices.begin() + clusterBegins[cluster] * 3,
+            indices.begin() + clusterBegins[cluster + 1] * 3);
+    }
+
+    indices = std::move(sorted);
+}
+
+// Orders the vertices by first use and rewrites the indices to match.
+// Vertices that no triangle uses are dropped.
+template <typename Vertex>
+void optimizeVertexFetch(
+    std::vector<std::uint32_t>& indices, std::vector<Vertex>& vertices)
+{
+    const auto unused = std::numeric_limits<std::uint32_t>::max();
+
+    std::vector<std::uint32_t> remap(vertices.size(), unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (auto& index : indices) {
+        auto& target = remap[index];
+
+        if (target == unused) {
+            target = static_cast<std::uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+
+        index = target;
+    }
+
+    vertices = std::move(reordered);
+}
+
+} // namespace MeshOptimizer
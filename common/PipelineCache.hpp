@@ -0,0 +1,120 @@
+#pragma once
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// A vk::PipelineCache that is loaded from a file at startup and written back
+// on save(). Data written by a different driver or device is discarded, so
+// the cache starts cold instead of being rejected by the driver.
+class PipelineCache {
+public:
+    PipelineCache(const vk::Device& device,
+        const vk::PhysicalDeviceProperties& props, std::string path)
+        : m_device(device)
+        , m_path(std::move(path))
+    {
+        const auto data = load(props);
+
+        m_warm = !data.empty();
+        m_cache = m_device.createPipelineCache({ {}, data.size(), data.data() });
+    }
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    ~PipelineCache() { m_device.destroyPipelineCache(m_cache); }
+
+    const vk::PipelineCache& handle() const { return m_cache; }
+
+    // Whether valid data was loaded from disk
+    bool warm() const { return m_warm; }
+
+    // Writes the cache next to the target file and renames it over the
+    // target, so a crash never leaves a truncated cache behind
+    bool save() const noexcept
+    {
+        try {
+            const auto data = m_device.getPipelineCacheData(m_cache);
+            const auto tmpPath = m_path + ".tmp";
+
+            {
+                std::ofstream file(
+                    tmpPath, std::ios_base::binary | std::ios_base::trunc);
+                file.write(reinterpret_cast<const char*>(data.data()),
+                    static_cast<std::streamsize>(data.size()));
+
+                if (!file.good()) {
+                    return false;
+                }
+            }
+
+#if defined(_WIN32)
+            return MoveFileExA(tmpPath.c_str(), m_path.c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)
+                != 0;
+#else
+            return std::rename(tmpPath.c_str(), m_path.c_str()) == 0;
+#endif
+        } catch (...) {
+            return false;
+        }
+    }
+
+private:
+    // Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+    struct Header {
+        std::uint32_t headerSize;
+        std::uint32_t headerVersion;
+        std::uint32_t vendorID;
+        std::uint32_t deviceID;
+        std::uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+
+    std::vector<char> load(const vk::PhysicalDeviceProperties& props) const
+    {
+        std::ifstream file(m_path, std::ios_base::binary);
+
+        if (file.fail()) {
+            return {};
+        }
+
+        const std::vector<char> data{ std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>() };
+
+        if (data.size() < sizeof(Header)) {
+            return {};
+        }
+
+        Header header;
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        if (header.headerSize < sizeof(Header)
+            || header.headerSize > data.size()
+            || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            || header.vendorID != props.vendorID
+            || header.deviceID != props.deviceID
+            || std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID,
+                   VK_UUID_SIZE)
+                != 0) {
+            return {};
+        }
+
+        return data;
+    }
+
+    vk::Device m_device;
+    std::string m_path;
+    vk::PipelineCache m_cache;
+    bool m_warm = false;
+};
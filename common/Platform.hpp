@@ -0,0 +1,26 @@
+#pragma once
+
+// Selects the window, surface and event loop backend for the target. Render
+// code includes this header instead of any system header.
+//
+// Every backend provides:
+//   explicit Backend(const PlatformConfig&);
+//   static std::vector<const char*> instanceExtensions();
+//   vk::Extent2D extent() const;
+//   void setTitle(const std::string&);
+//   void requestRedraw();
+//   int run(const std::function<bool()>& frame);
+// Backends that present also provide
+//   vk::SurfaceKHR createSurface(const vk::Instance&) const;
+
+#include "PlatformConfig.hpp"
+
+#if defined(HEADLESS)
+#include "HeadlessPlatform.hpp"
+using Platform = HeadlessPlatform;
+#elif defined(_WIN32)
+#include "Win32Platform.hpp"
+using Platform = Win32Platform;
+#else
+#error "No windowing backend for this platform; build with HEADLESS"
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// How the platform main loop paces calls to the frame callback
+enum class LoopMode {
+    // Call it as often as possible; presentation or fences set the pace
+    eContinuous,
+    // Call it at most maxFrameRate times per second and sleep in between
+    eLimited,
+    // Call it only after an event that needs a redraw, such as an expose or
+    // a resize, or after requestRedraw(); block on events otherwise
+    eOnDemand,
+};
+
+struct PlatformConfig {
+    std::string title = "vulkan-playground";
+    std::uint32_t width = 720;
+    std::uint32_t height = 480;
+    // Whether the user may resize the window. Ignored when headless.
+    bool resizable = false;
+    LoopMode loopMode = LoopMode::eContinuous;
+    // Only used with LoopMode::eLimited
+    double maxFrameRate = 60.0;
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Choosing how a swapchain presents, trading tearing and power for latency:
+//
+//   fifo       Waits for vertical blank with a queue of images. Never tears
+//              and is always supported, but every queued image adds a
+//              refresh of latency.
+//   mailbox    Waits for vertical blank, but a new image replaces the one
+//              waiting instead of queueing behind it. Never tears, and the
+//              image shown is the latest one, at the cost of rendering
+//              frames that are never shown.
+//   immediate  Shows a new image right away. Lowest latency, but tears.
+namespace PresentMode {
+
+// Parses one of the names above, throwing on anything else
+static inline vk::PresentModeKHR parse(const char* name)
+{
+    if (std::strcmp(name, "fifo") == 0) {
+        return vk::PresentModeKHR::eFifo;
+    }
+    if (std::strcmp(name, "mailbox") == 0) {
+        return vk::PresentModeKHR::eMailbox;
+    }
+    if (std::strcmp(name, "immediate") == 0) {
+        return vk::PresentModeKHR::eImmediate;
+    }
+
+    throw std::runtime_error(std::string("Unknown present mode: ") + name);
+}
+
+static inline const char* name(vk::PresentModeKHR mode)
+{
+    switch (mode) {
+    case vk::PresentModeKHR::eFifo:
+        return "fifo";
+    case vk::PresentModeKHR::eFifoRelaxed:
+        return "fifo_relaxed";
+    case vk::PresentModeKHR::eMailbox:
+        return "mailbox";
+    case vk::PresentModeKHR::eImmediate:
+        return "immediate";
+    default:
+        return "other";
+    }
+}
+
+// The wanted mode if the surface supports it. Otherwise immediate falls back
+// to mailbox, which doesn't block either, and both fall back to fifo.
+static inline vk::PresentModeKHR select(
+    const std::vector<vk::PresentModeKHR>& available, vk::PresentModeKHR wanted)
+{
+    const auto supported = [&](vk::PresentModeKHR mode) {
+        return std::find(available.cbegin(), available.cend(), mode)
+            != available.cend();
+    };
+
+    if (supported(wanted)) {
+        return wanted;
+    }
+
+    if (wanted == vk::PresentModeKHR::eImmediate
+        && supported(vk::PresentModeKHR::eMailbox)) {
+        return vk::PresentModeKHR::eMailbox;
+    }
+
+    return vk::PresentModeKHR::eFifo;
+}
+
+// The number of images to create the swapchain with, as close to wanted as
+// the surface allows. A maxImageCount of 0 means there is no maximum.
+static inline std::uint32_t imageCount(
+    const vk::SurfaceCapabilitiesKHR& capabilities, std::uint32_t wanted)
+{
+    auto count = std::max(wanted, capabilities.minImageCount);
+
+    if (capabilities.maxImageCount != 0) {
+        count = std::min(count, capabilities.maxImageCount);
+    }
+
+    return count;
+}
+
+} // namespace PresentMode
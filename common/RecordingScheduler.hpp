@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "WorkerThreads.hpp"
+
+// Records the draws of a render pass in parallel.
+//
+// The draws are split into contiguous ranges, one per thread, and each range
+// is recorded into a secondary command buffer that the primary buffer
+// executes. The calling thread records the first range itself. Every thread
+// allocates from its own command pool per frame in flight, so recording
+// needs no locking, and pools are reset as a whole instead of freeing
+// buffers.
+class RecordingScheduler {
+public:
+    // Records the draws [first, first + count) into a secondary command
+    // buffer that has already begun. It is called concurrently and must not
+    // touch shared state without synchronization.
+    using RecordFunction = std::function<void(
+        const vk::CommandBuffer&, std::uint32_t first, std::uint32_t count)>;
+
+    RecordingScheduler(const vk::Device& device,
+        std::uint32_t queueFamilyIndex, std::uint32_t framesInFlight,
+        std::uint32_t threadCount = std::thread::hardware_concurrency())
+        : m_device(device)
+        , m_framesInFlight(framesInFlight)
+        , m_threads(threadCount)
+        , m_slots(m_threads.threadCount() * framesInFlight)
+    {
+        for (auto& slot : m_slots) {
+            slot.pool = m_device.createCommandPool(
+                { vk::CommandPoolCreateFlagBits::eTransient,
+                    queueFamilyIndex });
+        }
+    }
+
+    RecordingScheduler(const RecordingScheduler&) = delete;
+    RecordingScheduler& operator=(const RecordingScheduler&) = delete;
+
+    ~RecordingScheduler()
+    {
+        // Destroying the pools frees their command buffers
+        for (const auto& slot : m_slots) {
+            m_device.destroyCommandPool(slot.pool);
+        }
+    }
+
+    std::uint32_t threadCount() const { return m_threads.threadCount(); }
+
+    // Resets the command pools of the frame. The caller must have waited for
+    // the frame's previous submission to complete.
+    void beginFrame(std::uint32_t frameIndex)
+    {
+        m_frameIndex = frameIndex;
+
+        for (std::uint32_t thread = 0; thread < threadCount(); thread++) {
+            auto& slot = this->slot(thread);
+            m_device.resetCommandPool(slot.pool, {});
+            slot.used = 0;
+        }
+    }
+
+    // Records drawCount draws across the threads into secondary command
+    // buffers that continue the subpass described by inheritance. Returns
+    // the buffers in draw order, to be executed with executeCommands(). A
+    // range of draws is never empty, so fewer draws than threads produce
+    // fewer buffers, and no draws none, which must not be executed.
+    const std::vector<vk::CommandBuffer>& record(
+        const vk::CommandBufferInheritanceInfo& inheritance,
+        std::uint32_t drawCount, const RecordFunction& recordDraws)
+    {
+        const auto rangeCount = std::min(drawCount, threadCount());
+
+        m_recorded.assign(rangeCount, vk::CommandBuffer{});
+
+        // Each range runs on the thread of the same index, which owns the
+        // slot it records into
+        m_threads.run(rangeCount, [&](std::uint32_t thread) {
+            recordRange(inheritance, recordDraws, drawCount, rangeCount,
+                thread);
+        });
+
+        return m_recorded;
+    }
+
+private:
+    struct Slot {
+        vk::CommandPool pool;
+        // Allocated once and reused after every reset of the pool
+        std::vector<vk::CommandBuffer> buffers;
+        std::size_t used = 0;
+    };
+
+    Slot& slot(std::uint32_t thread)
+    {
+        return m_slots.at(thread * m_framesInFlight + m_frameIndex);
+    }
+
+    void recordRange(const vk::CommandBufferInheritanceInfo& inheritance,
+        const RecordFunction& recordDraws, std::uint32_t drawCount,
+        std::uint32_t rangeCount, std::uint32_t thread)
+    {
+        auto& slot = this->slot(thread);
+
+        if (slot.used == slot.buffers.size()) {
+            const auto buffers = m_device.allocateCommandBuffers(
+                { slot.pool, vk::CommandBufferLevel::eSecondary, 1 });
+            slot.buffers.push_back(buffers.at(0));
+        }
+
+        const auto& commandBuffer = slot.buffers.at(slot.used++);
+
+        const auto first = static_cast<std::uint32_t>(
+            std::uint64_t{ drawCount } * thread / rangeCount);
+        const auto last = static_cast<std::uint32_t>(
+            std::uint64_t{ drawCount } * (thread + 1) / rangeCount);
+
+        commandBuffer.begin(
+            { vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+                    | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+                &inheritance });
+
+        recordDraws(commandBuffer, first, last - first);
+
+        commandBuffer.end();
+
+        m_recorded.at(thread) = commandBuffer;
+    }
+
+    vk::Device m_device;
+    std::uint32_t m_framesInFlight;
+    WorkerThreads m_threads;
+    std::vector<Slot> m_slots;
+    std::uint32_t m_frameIndex = 0;
+
+    // Written by each thread at its own index
+    std::vector<vk::CommandBuffer> m_recorded;
+};
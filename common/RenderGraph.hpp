@@ -0,0 +1,744 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DeletionQueue.hpp"
+#include "MemoryAllocator.hpp"
+#include "TransientAttachmentPool.hpp"
+
+// A frame described as passes and the resources they use.
+//
+// Passes run in the order they were added, and declare how they use each
+// resource. compile() derives from consecutive uses of each resource the
+// pipeline barrier recorded before each pass, and the attachments, load and
+// store ops, layouts and external dependency of each graphics pass's render
+// pass. The uses of a buffer wrap around from the end of a frame to the start
+// of the next, so that persistent buffers are synchronized across frames too.
+//
+// Images created by the graph only live within a frame. Each frame in flight
+// has its own, from a TransientAttachmentPool, and within a frame the images
+// whose passes don't overlap share memory. Imported buffers are only named
+// here; the caller owns them. Imported images, e.g. swapchain images, are set
+// before each frame, start it undefined and end it in their final layout.
+//
+// With a deletion queue, the objects the graph destroys are retired to it,
+// so that the images can be recreated while the GPU still uses them.
+class RenderGraph {
+public:
+    using Resource = std::uint32_t;
+    using Pass = std::uint32_t;
+
+    enum class PassType { eCompute, eGraphics };
+
+    enum class Usage {
+        eIndirectRead,
+        eVertexRead,
+        // Storage buffers, or sampled images
+        eComputeRead,
+        // Storage buffers or images, read and written
+        eComputeWrite,
+        // Sampled images
+        eFragmentRead,
+        eColorAttachment,
+        eDepthAttachment,
+    };
+
+    struct PassContext {
+        vk::CommandBuffer commandBuffer;
+        std::uint32_t frameIndex;
+        vk::Extent2D extent;
+        // Within which a graphics pass records, null for compute passes
+        vk::RenderPass renderPass;
+        vk::Framebuffer framebuffer;
+    };
+
+    using RecordFunction = std::function<void(const PassContext& context)>;
+
+    RenderGraph(const vk::Device& device, MemoryAllocator& allocator,
+        DeletionQueue* deletionQueue = nullptr)
+        : m_device(device)
+        , m_deletionQueue(deletionQueue)
+        , m_attachmentPool(device, allocator, deletionQueue)
+    {
+    }
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    ~RenderGraph()
+    {
+        releaseTargets();
+
+        for (const auto& pass : m_passes) {
+            if (pass.renderPass) {
+                dispose(pass.renderPass);
+            }
+        }
+    }
+
+    Resource importBuffer(const char* name)
+    {
+        return addResource({ name, ResourceType::eBuffer });
+    }
+
+    Resource importImage(
+        const char* name, vk::Format format, vk::ImageLayout finalLayout)
+    {
+        return addResource(
+            { name, ResourceType::eImportedImage, format, finalLayout });
+    }
+
+    Resource createImage(const char* name, vk::Format format)
+    {
+        return addResource({ name, ResourceType::eCreatedImage, format });
+    }
+
+    // Graphics passes draw in a render pass of their own, begun with
+    // contents, e.g. secondary command buffers
+    Pass addPass(const char* name, PassType type,
+        vk::SubpassContents contents = vk::SubpassContents::eInline)
+    {
+        m_passes.push_back({ name, type, contents });
+
+        return static_cast<Pass>(m_passes.size() - 1);
+    }
+
+    // What a pass records, which usually needs objects that only exist once
+    // the graph has been compiled, such as pipelines
+    void setRecord(Pass pass, RecordFunction record)
+    {
+        m_passes.at(pass).record = std::move(record);
+    }
+
+    // What to record right before and after a pass, after its barrier and
+    // outside its render pass, e.g. to profile it. Graphics passes may only
+    // record inside their render pass what their contents allow.
+    void setAround(Pass pass, RecordFunction before, RecordFunction after)
+    {
+        auto& info = m_passes.at(pass);
+        info.before = std::move(before);
+        info.after = std::move(after);
+    }
+
+    // A pass uses each resource at most once; read and written is
+    // eComputeWrite
+    void use(Pass pass, Resource resource, Usage usage)
+    {
+        auto& uses = m_passes.at(pass).uses;
+
+        for (const auto& use : uses) {
+            if (use.resource == resource) {
+                throw std::runtime_error("Pass " + m_passes[pass].name
+                    + " uses " + m_resources.at(resource).name + " twice");
+            }
+        }
+
+        uses.push_back({ resource, usage, false, {} });
+    }
+
+    // An attachment the pass clears instead of loading
+    void clear(Pass pass, Resource resource, const vk::ClearValue& value)
+    {
+        for (auto& use : m_passes.at(pass).uses) {
+            if (use.resource == resource) {
+                use.clear = true;
+                use.clearValue = value;
+                return;
+            }
+        }
+
+        throw std::runtime_error("Pass " + m_passes[pass].name
+            + " clears " + m_resources.at(resource).name
+            + " without using it");
+    }
+
+    // Derives the barriers and creates the render passes, once, after every
+    // pass has been added. Images are created by setExtent().
+    void compile(std::uint32_t framesInFlight)
+    {
+        m_framesInFlight = framesInFlight;
+
+        // Uses of each resource, in pass order
+        for (Pass pass = 0; pass < m_passes.size(); pass++) {
+            const auto& passInfo = m_passes[pass];
+
+            for (std::size_t i = 0; i < passInfo.uses.size(); i++) {
+                const auto& use = passInfo.uses[i];
+                const auto attachment = isAttachment(use.usage);
+
+                if (attachment && passInfo.type != PassType::eGraphics) {
+                    throw std::runtime_error("Compute pass " + passInfo.name
+                        + " uses an attachment");
+                }
+
+                auto& resource = m_resources.at(use.resource);
+
+                if (attachment && resource.type == ResourceType::eBuffer) {
+                    throw std::runtime_error(
+                        "Buffer " + resource.name + " used as an attachment");
+                }
+
+                resource.uses.push_back({ pass, i });
+                resource.imageUsage |= imageUsage(use.usage);
+            }
+        }
+
+        for (Pass pass = 0; pass < m_passes.size(); pass++) {
+            compilePass(pass);
+        }
+
+        // Imported images left in another layout by their last use are
+        // transitioned at the end of the frame
+        for (Resource resource = 0; resource < m_resources.size();
+             resource++) {
+            const auto& resourceInfo = m_resources[resource];
+
+            if (resourceInfo.type != ResourceType::eImportedImage
+                || resourceInfo.uses.empty()) {
+                continue;
+            }
+
+            const auto& last = useAt(resourceInfo.uses.back());
+            const auto access = accessOf(last.usage);
+
+            if (isAttachment(last.usage)
+                || access.layout == resourceInfo.finalLayout) {
+                continue;
+            }
+
+            auto& barrier = m_finalBarrier;
+            barrier.srcStages |= access.stages;
+            barrier.dstStages |= vk::PipelineStageFlagBits::eBottomOfPipe;
+            barrier.images.push_back({ resource, access.writeAccess, {},
+                access.layout, resourceInfo.finalLayout });
+        }
+    }
+
+    const vk::RenderPass& renderPass(Pass pass) const
+    {
+        return m_passes.at(pass).renderPass;
+    }
+
+    // Creates the images for every frame in flight at extent, replacing
+    // the previous ones as releaseTargets() does.
+    void setExtent(const vk::Extent2D& extent)
+    {
+        releaseTargets();
+        m_extent = extent;
+
+        for (std::uint32_t frame = 0; frame < m_framesInFlight; frame++) {
+            for (auto& resource : m_resources) {
+                if (resource.type != ResourceType::eCreatedImage
+                    || resource.uses.empty()) {
+                    continue;
+                }
+
+                const auto first = resource.uses.front().pass;
+                const auto last = resource.uses.back().pass;
+
+                resource.attachments.push_back(m_attachmentPool.add(
+                    resource.format, extent, resource.imageUsage,
+                    aspectOf(resource.format), first, last));
+            }
+
+            // Allocated apart, so that only the images of a frame alias
+            m_attachmentPool.allocate();
+        }
+    }
+
+    // Destroys the images and framebuffers, e.g. before the imported images
+    // they were made with go away. Without a deletion queue, the GPU must be
+    // done with them.
+    void releaseTargets()
+    {
+        for (auto& pass : m_passes) {
+            for (const auto& framebuffer : pass.framebuffers) {
+                dispose(framebuffer.second);
+            }
+            pass.framebuffers.clear();
+        }
+
+        for (auto& resource : m_resources) {
+            resource.attachments.clear();
+        }
+
+        m_attachmentPool.clear();
+    }
+
+    // Sets the image an imported image resource stands for this frame
+    void setImage(
+        Resource resource, const vk::Image& image, const vk::ImageView& view)
+    {
+        auto& resourceInfo = m_resources.at(resource);
+
+        resourceInfo.image = image;
+        resourceInfo.view = view;
+    }
+
+    // Records every pass with the barriers before it
+    void execute(
+        const vk::CommandBuffer& commandBuffer, std::uint32_t frameIndex)
+    {
+        for (auto& pass : m_passes) {
+            recordBarrier(commandBuffer, pass.barrier, frameIndex);
+
+            PassContext context{ commandBuffer, frameIndex, m_extent, {}, {} };
+
+            if (pass.type == PassType::eGraphics) {
+                context.renderPass = pass.renderPass;
+                context.framebuffer = framebuffer(pass, frameIndex);
+            }
+
+            if (pass.before) {
+                pass.before(context);
+            }
+
+            if (pass.type == PassType::eGraphics) {
+                commandBuffer.beginRenderPass(
+                    { pass.renderPass, context.framebuffer,
+                        { { 0, 0 }, m_extent },
+                        static_cast<std::uint32_t>(pass.clearValues.size()),
+                        pass.clearValues.data() },
+                    pass.contents);
+            }
+
+            if (pass.record) {
+                pass.record(context);
+            }
+
+            if (pass.type == PassType::eGraphics) {
+                commandBuffer.endRenderPass();
+            }
+
+            if (pass.after) {
+                pass.after(context);
+            }
+        }
+
+        recordBarrier(commandBuffer, m_finalBarrier, frameIndex);
+    }
+
+    // Memory of the created images, for every frame in flight
+    const TransientAttachmentPool::Report& memoryReport() const
+    {
+        return m_attachmentPool.report();
+    }
+
+private:
+    enum class ResourceType { eBuffer, eImportedImage, eCreatedImage };
+
+    struct UseRef {
+        Pass pass;
+        std::size_t index;
+    };
+
+    struct ResourceInfo {
+        std::string name;
+        ResourceType type;
+        vk::Format format;
+        vk::ImageLayout finalLayout;
+
+        std::vector<UseRef> uses;
+        vk::ImageUsageFlags imageUsage;
+        // Created images, per frame in flight
+        std::vector<TransientAttachmentPool::Attachment> attachments;
+        // Imported images, for the current frame
+        vk::Image image;
+        vk::ImageView view;
+    };
+
+    struct Use {
+        Resource resource;
+        Usage usage;
+        bool clear;
+        vk::ClearValue clearValue;
+    };
+
+    struct Access {
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+        // The part of access that writes
+        vk::AccessFlags writeAccess;
+        vk::ImageLayout layout;
+    };
+
+    struct ImageBarrier {
+        Resource resource;
+        vk::AccessFlags srcAccess;
+        vk::AccessFlags dstAccess;
+        vk::ImageLayout oldLayout;
+        vk::ImageLayout newLayout;
+    };
+
+    // Buffers are synchronized with a global memory barrier
+    struct Barrier {
+        vk::PipelineStageFlags srcStages;
+        vk::PipelineStageFlags dstStages;
+        vk::AccessFlags srcAccess;
+        vk::AccessFlags dstAccess;
+        std::vector<ImageBarrier> images;
+    };
+
+    struct PassInfo {
+        std::string name;
+        PassType type;
+        vk::SubpassContents contents;
+        RecordFunction record;
+        RecordFunction before;
+        RecordFunction after;
+
+        std::vector<Use> uses;
+        Barrier barrier;
+        vk::RenderPass renderPass;
+        // Uses that are attachments, in attachment order
+        std::vector<std::size_t> attachmentUses;
+        std::vector<vk::ClearValue> clearValues;
+        // By the views of the attachments
+        std::map<std::vector<VkImageView>, vk::Framebuffer> framebuffers;
+    };
+
+    static bool isAttachment(Usage usage)
+    {
+        return usage == Usage::eColorAttachment
+            || usage == Usage::eDepthAttachment;
+    }
+
+    static Access accessOf(Usage usage)
+    {
+        using Stage = vk::PipelineStageFlagBits;
+        using AccessBit = vk::AccessFlagBits;
+        using Layout = vk::ImageLayout;
+
+        switch (usage) {
+        case Usage::eIndirectRead:
+            return { Stage::eDrawIndirect, AccessBit::eIndirectCommandRead,
+                {}, Layout::eUndefined };
+        case Usage::eVertexRead:
+            return { Stage::eVertexInput, AccessBit::eVertexAttributeRead, {},
+                Layout::eUndefined };
+        case Usage::eComputeRead:
+            return { Stage::eComputeShader, AccessBit::eShaderRead, {},
+                Layout::eShaderReadOnlyOptimal };
+        case Usage::eComputeWrite:
+            return { Stage::eComputeShader,
+                AccessBit::eShaderRead | AccessBit::eShaderWrite,
+                AccessBit::eShaderWrite, Layout::eGeneral };
+        case Usage::eFragmentRead:
+            return { Stage::eFragmentShader, AccessBit::eShaderRead, {},
+                Layout::eShaderReadOnlyOptimal };
+        case Usage::eColorAttachment:
+            return { Stage::eColorAttachmentOutput,
+                AccessBit::eColorAttachmentRead
+                    | AccessBit::eColorAttachmentWrite,
+                AccessBit::eColorAttachmentWrite,
+                Layout::eColorAttachmentOptimal };
+        case Usage::eDepthAttachment:
+            return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+                AccessBit::eDepthStencilAttachmentRead
+                    | AccessBit::eDepthStencilAttachmentWrite,
+                AccessBit::eDepthStencilAttachmentWrite,
+                Layout::eDepthStencilAttachmentOptimal };
+        }
+
+        return {};
+    }
+
+    static vk::ImageUsageFlags imageUsage(Usage usage)
+    {
+        switch (usage) {
+        case Usage::eComputeRead:
+        case Usage::eFragmentRead:
+            return vk::ImageUsageFlagBits::eSampled;
+        case Usage::eComputeWrite:
+            return vk::ImageUsageFlagBits::eStorage;
+        case Usage::eColorAttachment:
+            return vk::ImageUsageFlagBits::eColorAttachment;
+        case Usage::eDepthAttachment:
+            return vk::ImageUsageFlagBits::eDepthStencilAttachment;
+        default:
+            return {};
+        }
+    }
+
+    static vk::ImageAspectFlags aspectOf(vk::Format format)
+    {
+        switch (format) {
+        case vk::Format::eD16Unorm:
+        case vk::Format::eX8D24UnormPack32:
+        case vk::Format::eD32Sfloat:
+            return vk::ImageAspectFlagBits::eDepth;
+        case vk::Format::eD16UnormS8Uint:
+        case vk::Format::eD24UnormS8Uint:
+        case vk::Format::eD32SfloatS8Uint:
+            return vk::ImageAspectFlagBits::eDepth
+                | vk::ImageAspectFlagBits::eStencil;
+        default:
+            return vk::ImageAspectFlagBits::eColor;
+        }
+    }
+
+    Resource addResource(ResourceInfo resource)
+    {
+        m_resources.push_back(std::move(resource));
+
+        return static_cast<Resource>(m_resources.size() - 1);
+    }
+
+    const Use& useAt(const UseRef& ref) const
+    {
+        return m_passes[ref.pass].uses[ref.index];
+    }
+
+    // What the use at uses[position] of a resource must wait for: the use
+    // before it, which for a buffer's first use is its last use in the
+    // previous frame. An image's first use starts from an undefined layout
+    // and waits for its own stages, which the semaphores of imported images
+    // wait at, and for the last uses of the created images it may alias.
+    Access previousAccess(const ResourceInfo& resource, std::size_t position)
+    {
+        if (position > 0 || resource.type == ResourceType::eBuffer) {
+            const auto previous
+                = position > 0 ? position - 1 : resource.uses.size() - 1;
+
+            return accessOf(useAt(resource.uses[previous]).usage);
+        }
+
+        const auto& use = useAt(resource.uses[position]);
+        auto access = accessOf(use.usage);
+        access.access = {};
+        access.writeAccess = {};
+        access.layout = vk::ImageLayout::eUndefined;
+
+        if (resource.type != ResourceType::eCreatedImage) {
+            return access;
+        }
+
+        for (const auto& other : m_resources) {
+            if (other.type != ResourceType::eCreatedImage
+                || other.uses.empty()
+                || other.uses.back().pass >= resource.uses.front().pass) {
+                continue;
+            }
+
+            const auto otherAccess
+                = accessOf(useAt(other.uses.back()).usage);
+            access.stages |= otherAccess.stages;
+            access.writeAccess |= otherAccess.writeAccess;
+        }
+
+        return access;
+    }
+
+    void compilePass(Pass pass)
+    {
+        auto& passInfo = m_passes[pass];
+
+        // The external dependency of the render pass, for its attachments
+        vk::PipelineStageFlags srcStages;
+        vk::PipelineStageFlags dstStages;
+        vk::AccessFlags srcAccess;
+        vk::AccessFlags dstAccess;
+        std::vector<vk::AttachmentDescription> attachments;
+        std::vector<vk::AttachmentReference> colorReferences;
+        vk::AttachmentReference depthReference{ VK_ATTACHMENT_UNUSED,
+            vk::ImageLayout::eUndefined };
+
+        for (std::size_t i = 0; i < passInfo.uses.size(); i++) {
+            const auto& use = passInfo.uses[i];
+            const auto& resource = m_resources[use.resource];
+            const auto access = accessOf(use.usage);
+
+            std::size_t position = 0;
+            while (resource.uses[position].pass != pass) {
+                position++;
+            }
+
+            const auto previous = previousAccess(resource, position);
+            const auto image = resource.type != ResourceType::eBuffer;
+            const auto layoutChange
+                = image && previous.layout != access.layout;
+
+            if (isAttachment(use.usage)) {
+                srcStages |= previous.stages;
+                dstStages |= access.stages;
+                srcAccess |= previous.writeAccess;
+                dstAccess |= access.access;
+
+                const auto first = position == 0;
+                const auto last = position + 1 == resource.uses.size();
+                const auto imported
+                    = resource.type == ResourceType::eImportedImage;
+
+                const auto loadOp = use.clear ? vk::AttachmentLoadOp::eClear
+                    : first                   ? vk::AttachmentLoadOp::eDontCare
+                                              : vk::AttachmentLoadOp::eLoad;
+                const auto storeOp = !last || imported
+                    ? vk::AttachmentStoreOp::eStore
+                    : vk::AttachmentStoreOp::eDontCare;
+
+                const auto attachment
+                    = static_cast<std::uint32_t>(attachments.size());
+
+                attachments.push_back({ {}, resource.format,
+                    vk::SampleCountFlagBits::e1, loadOp, storeOp,
+                    vk::AttachmentLoadOp::eDontCare,
+                    vk::AttachmentStoreOp::eDontCare, previous.layout,
+                    last && imported ? resource.finalLayout : access.layout });
+
+                if (use.usage == Usage::eColorAttachment) {
+                    colorReferences.push_back({ attachment, access.layout });
+                } else {
+                    depthReference = { attachment, access.layout };
+                }
+
+                passInfo.attachmentUses.push_back(i);
+                passInfo.clearValues.push_back(use.clearValue);
+                continue;
+            }
+
+            // Reads after reads don't wait for each other
+            if (!previous.writeAccess && !access.writeAccess && !layoutChange) {
+                continue;
+            }
+
+            auto& barrier = passInfo.barrier;
+            barrier.srcStages |= previous.stages;
+            barrier.dstStages |= access.stages;
+
+            if (image) {
+                barrier.images.push_back({ use.resource, previous.writeAccess,
+                    access.access, previous.layout, access.layout });
+            } else if (previous.writeAccess) {
+                barrier.srcAccess |= previous.writeAccess;
+                barrier.dstAccess |= access.access;
+            }
+        }
+
+        if (passInfo.type != PassType::eGraphics) {
+            return;
+        }
+
+        const vk::SubpassDescription subpass{ {},
+            vk::PipelineBindPoint::eGraphics, 0, nullptr,
+            static_cast<std::uint32_t>(colorReferences.size()),
+            colorReferences.data(), nullptr,
+            depthReference.attachment != VK_ATTACHMENT_UNUSED ? &depthReference
+                                                              : nullptr,
+            0, nullptr };
+
+        const vk::SubpassDependency dependency{ VK_SUBPASS_EXTERNAL, 0,
+            srcStages, dstStages, srcAccess, dstAccess, {} };
+
+        passInfo.renderPass = m_device.createRenderPass({ {},
+            static_cast<std::uint32_t>(attachments.size()), attachments.data(),
+            1, &subpass, 1, &dependency });
+    }
+
+    const vk::Image& image(Resource resource, std::uint32_t frameIndex) const
+    {
+        const auto& resourceInfo = m_resources[resource];
+
+        return resourceInfo.type == ResourceType::eCreatedImage
+            ? m_attachmentPool.image(resourceInfo.attachments.at(frameIndex))
+            : resourceInfo.image;
+    }
+
+    const vk::ImageView& view(
+        Resource resource, std::uint32_t frameIndex) const
+    {
+        const auto& resourceInfo = m_resources[resource];
+
+        return resourceInfo.type == ResourceType::eCreatedImage
+            ? m_attachmentPool.view(resourceInfo.attachments.at(frameIndex))
+            : resourceInfo.view;
+    }
+
+    // Framebuffers are made on first use with each set of attachments, so
+    // there ends up being one per frame in flight and imported image
+    vk::Framebuffer framebuffer(PassInfo& pass, std::uint32_t frameIndex)
+    {
+        std::vector<vk::ImageView> views;
+        std::vector<VkImageView> key;
+
+        for (const auto i : pass.attachmentUses) {
+            views.push_back(view(pass.uses[i].resource, frameIndex));
+            key.push_back(static_cast<VkImageView>(views.back()));
+        }
+
+        auto& framebuffer = pass.framebuffers[key];
+
+        if (!framebuffer) {
+            framebuffer = m_device.createFramebuffer({ {}, pass.renderPass,
+                static_cast<std::uint32_t>(views.size()), views.data(),
+                m_extent.width, m_extent.height, 1 });
+        }
+
+        return framebuffer;
+    }
+
+    void recordBarrier(const vk::CommandBuffer& commandBuffer,
+        const Barrier& barrier, std::uint32_t frameIndex)
+    {
+        if (!barrier.srcStages) {
+            return;
+        }
+
+        m_imageBarriers.clear();
+
+        for (const auto& imageBarrier : barrier.images) {
+            const auto resource = imageBarrier.resource;
+
+            m_imageBarriers.push_back({ imageBarrier.srcAccess,
+                imageBarrier.dstAccess, imageBarrier.oldLayout,
+                imageBarrier.newLayout, VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED, image(resource, frameIndex),
+                { aspectOf(m_resources[resource].format), 0, 1, 0, 1 } });
+        }
+
+        const vk::MemoryBarrier memoryBarrier{ barrier.srcAccess,
+            barrier.dstAccess };
+
+        commandBuffer.pipelineBarrier(barrier.srcStages, barrier.dstStages, {},
+            barrier.srcAccess ? 1 : 0, &memoryBarrier, 0, nullptr,
+            static_cast<std::uint32_t>(m_imageBarriers.size()),
+            m_imageBarriers.data());
+    }
+
+    void dispose(const vk::Framebuffer& framebuffer)
+    {
+        if (m_deletionQueue != nullptr) {
+            m_deletionQueue->retire(framebuffer);
+        } else {
+            m_device.destroyFramebuffer(framebuffer);
+        }
+    }
+
+    void dispose(const vk::RenderPass& renderPass)
+    {
+        if (m_deletionQueue != nullptr) {
+            m_deletionQueue->retire(renderPass);
+        } else {
+            m_device.destroyRenderPass(renderPass);
+        }
+    }
+
+    vk::Device m_device;
+    DeletionQueue* m_deletionQueue;
+    TransientAttachmentPool m_attachmentPool;
+
+    std::vector<ResourceInfo> m_resources;
+    std::vector<PassInfo> m_passes;
+    Barrier m_finalBarrier;
+
+    std::uint32_t m_framesInFlight = 1;
+    vk::Extent2D m_extent;
+
+    std::vector<vk::ImageMemoryBarrier> m_imageBarriers;
+};
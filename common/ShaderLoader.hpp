@@ -0,0 +1,217 @@
+#pragma once
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A read-only memory mapping of a SPIR-V file. Mapped views start on a page
+// boundary, so the words can be passed to Vulkan without copying them into
+// an aligned buffer first.
+class SpirvFile {
+public:
+    static constexpr std::uint32_t magicNumber = 0x07230203;
+    // Magic number, version, generator, bound and schema
+    static constexpr std::size_t headerSize = 5 * sizeof(std::uint32_t);
+
+    explicit SpirvFile(const std::string& path)
+    {
+        map(path);
+
+        try {
+            validate(path);
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    SpirvFile(const SpirvFile&) = delete;
+    SpirvFile& operator=(const SpirvFile&) = delete;
+
+    SpirvFile(SpirvFile&& other) noexcept
+        : m_data(other.m_data)
+        , m_size(other.m_size)
+#if defined(_WIN32)
+        , m_mapping(other.m_mapping)
+#endif
+    {
+        other.m_data = nullptr;
+        other.m_size = 0;
+#if defined(_WIN32)
+        other.m_mapping = nullptr;
+#endif
+    }
+
+    ~SpirvFile() { unmap(); }
+
+    const std::uint32_t* code() const
+    {
+        return static_cast<const std::uint32_t*>(m_data);
+    }
+
+    // Size in bytes, always a multiple of four
+    std::size_t size() const { return m_size; }
+
+private:
+    void map(const std::string& path)
+    {
+#if defined(_WIN32)
+        const auto file = CreateFileA(path.c_str(), GENERIC_READ,
+            FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Can't open " + path);
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            throw std::runtime_error("Can't get the size of " + path);
+        }
+
+        m_size = static_cast<std::size_t>(size.QuadPart);
+
+        // Empty files can't be mapped; validate() rejects them
+        if (m_size > 0) {
+            m_mapping
+                = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+            if (m_mapping != nullptr) {
+                m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+            }
+        }
+
+        CloseHandle(file);
+
+        if (m_size > 0 && m_data == nullptr) {
+            unmap();
+            throw std::runtime_error("Can't map " + path);
+        }
+#else
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+            throw std::runtime_error("Can't open " + path);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Can't get the size of " + path);
+        }
+
+        m_size = static_cast<std::size_t>(st.st_size);
+
+        // Empty files can't be mapped; validate() rejects them
+        if (m_size > 0) {
+            void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (data != MAP_FAILED) {
+                m_data = data;
+            }
+        }
+
+        close(fd);
+
+        if (m_size > 0 && m_data == nullptr) {
+            throw std::runtime_error("Can't map " + path);
+        }
+#endif
+    }
+
+    void unmap()
+    {
+#if defined(_WIN32)
+        if (m_data != nullptr) {
+            UnmapViewOfFile(m_data);
+        }
+
+        if (m_mapping != nullptr) {
+            CloseHandle(m_mapping);
+        }
+
+        m_mapping = nullptr;
+#else
+        if (m_data != nullptr) {
+            munmap(m_data, m_size);
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    void validate(const std::string& path) const
+    {
+        if (m_size < headerSize || m_size % sizeof(std::uint32_t) != 0) {
+            throw std::runtime_error(path + " is not a SPIR-V module");
+        }
+
+        if (code()[0] != magicNumber) {
+            throw std::runtime_error(path + " has a wrong SPIR-V magic number");
+        }
+    }
+
+    void* m_data = nullptr;
+    std::size_t m_size = 0;
+#if defined(_WIN32)
+    HANDLE m_mapping = nullptr;
+#endif
+};
+
+namespace ShaderLoader {
+
+static inline vk::ShaderModule createShaderModule(
+    const vk::Device& device, const std::string& path)
+{
+    const SpirvFile file(path);
+
+    return device.createShaderModule({ {}, file.size(), file.code() });
+}
+
+// Maps every file before creating any module, so a missing or malformed file
+// is reported before the driver does any work. The modules are returned in
+// the order of paths.
+static inline std::vector<vk::ShaderModule> createShaderModules(
+    const vk::Device& device, const std::vector<std::string>& paths)
+{
+    std::vector<SpirvFile> files;
+    files.reserve(paths.size());
+
+    for (const auto& path : paths) {
+        files.emplace_back(path);
+    }
+
+    std::vector<vk::ShaderModule> modules;
+    modules.reserve(files.size());
+
+    try {
+        for (const auto& file : files) {
+            modules.push_back(
+                device.createShaderModule({ {}, file.size(), file.code() }));
+        }
+    } catch (...) {
+        for (const auto& module : modules) {
+            device.destroyShaderModule(module);
+        }
+
+        throw;
+    }
+
+    return modules;
+}
+
+} // namespace ShaderLoader
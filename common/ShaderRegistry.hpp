@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+// SPIR-V compiled into the executable by EmbedSpirv.cmake
+struct EmbeddedShader {
+    const char* name;
+    const std::uint32_t* code;
+    // Size in bytes
+    std::size_t size;
+};
+
+namespace ShaderRegistry {
+
+constexpr bool equal(const char* a, const char* b)
+{
+    return *a == *b && (*a == '\0' || equal(a + 1, b + 1));
+}
+
+// Looks up a shader by the file name it was compiled from. Used in a
+// constant expression, an unknown name or a module without the SPIR-V magic
+// number fails the build.
+template <std::size_t N>
+constexpr const EmbeddedShader& find(
+    const EmbeddedShader (&shaders)[N], const char* name)
+{
+    for (std::size_t i = 0; i < N; i++) {
+        if (equal(shaders[i].name, name)) {
+            if (shaders[i].size < 5 * sizeof(std::uint32_t)
+                || shaders[i].code[0] != 0x07230203) {
+                throw std::logic_error("Embedded shader is not SPIR-V");
+            }
+
+            return shaders[i];
+        }
+    }
+
+    throw std::logic_error("No such embedded shader");
+}
+
+static inline vk::ShaderModule createShaderModule(
+    const vk::Device& device, const EmbeddedShader& shader)
+{
+    return device.createShaderModule({ {}, shader.size, shader.code });
+}
+
+} // namespace ShaderRegistry
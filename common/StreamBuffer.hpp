@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+
+#include "MemoryAllocator.hpp"
+
+// A host-visible buffer for data the CPU rewrites every frame, such as
+// uniform data or per-instance attributes. It is split into one region per
+// frame in flight and stays mapped, so a frame only writes memory the GPU is
+// done with. The CPU should write it sequentially and never read it back, as
+// it may be write-combined.
+class StreamBuffer {
+public:
+    struct Range {
+        // Offset into buffer() to bind the data at
+        vk::DeviceSize offset;
+        char* data;
+    };
+
+    // Regions and the ranges reserved in them start at multiples of
+    // alignment, e.g. minUniformBufferOffsetAlignment for data bound with
+    // dynamic offsets
+    StreamBuffer(const vk::Device& device, MemoryAllocator& allocator,
+        const vk::BufferUsageFlags& usage, vk::DeviceSize alignment,
+        vk::DeviceSize regionSize, std::uint32_t regionCount)
+        : m_device(device)
+        , m_allocator(allocator)
+        , m_alignment(alignment)
+        , m_regionSize(alignUp(regionSize, alignment))
+    {
+        m_buffer = m_device.createBuffer({ {}, m_regionSize * regionCount,
+            usage, vk::SharingMode::eExclusive, 0, nullptr });
+
+        m_allocation = m_allocator.allocateBuffer(m_buffer,
+            vk::MemoryPropertyFlagBits::eHostVisible
+                | vk::MemoryPropertyFlagBits::eHostCoherent);
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    ~StreamBuffer()
+    {
+        m_device.destroyBuffer(m_buffer);
+        m_allocator.free(m_allocation);
+    }
+
+    const vk::Buffer& buffer() const { return m_buffer; }
+
+    // Starts writing into the region of the given frame. The caller must have
+    // waited for the frame's previous submission to complete.
+    void beginFrame(std::uint32_t regionIndex)
+    {
+        m_regionBegin = m_regionSize * regionIndex;
+        m_offset = 0;
+    }
+
+    // Reserves size bytes of the current region
+    Range reserve(vk::DeviceSize size)
+    {
+        const auto offset = alignUp(m_offset, m_alignment);
+
+        if (offset + size > m_regionSize) {
+            throw std::runtime_error("Stream buffer region exhausted");
+        }
+
+        m_offset = offset + size;
+
+        return { m_regionBegin + offset,
+            m_allocation.mapped + m_regionBegin + offset };
+    }
+
+private:
+    static vk::DeviceSize alignUp(vk::DeviceSize size, vk::DeviceSize alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    vk::Device m_device;
+    MemoryAllocator& m_allocator;
+    vk::DeviceSize m_alignment;
+    vk::DeviceSize m_regionSize;
+    vk::Buffer m_buffer;
+    MemoryAllocator::Allocation m_allocation;
+    vk::DeviceSize m_regionBegin = 0;
+    vk::DeviceSize m_offset = 0;
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Log.hpp"
+
+// Runs a set of tasks on a few threads, each as soon as the tasks it depends
+// on have completed, and records when every task ran.
+//
+// Tasks that fail or depend on a failed task are skipped; run() rethrows the
+// first failure once the tasks already started have completed.
+class TaskGraph {
+public:
+    using TaskId = std::size_t;
+
+    // Tasks may only depend on tasks added before them
+    TaskId add(const char* name, std::function<void()> work,
+        const std::vector<TaskId>& dependencies = {})
+    {
+        const auto id = m_tasks.size();
+
+        for (const auto dependency : dependencies) {
+            m_tasks.at(dependency).dependents.push_back(id);
+        }
+
+        m_tasks.push_back({ name, std::move(work), {},
+            static_cast<std::uint32_t>(dependencies.size()) });
+
+        return id;
+    }
+
+    // Runs every task, using the calling thread as one of the threads. May
+    // only be called once.
+    void run(std::uint32_t threadCount = std::thread::hardware_concurrency())
+    {
+        m_threadCount = std::max(
+            std::min(threadCount, static_cast<std::uint32_t>(m_tasks.size())),
+            1u);
+        m_remaining = m_tasks.size();
+        m_error = nullptr;
+        m_ready.clear();
+
+        for (TaskId id = 0; id < m_tasks.size(); id++) {
+            if (m_tasks[id].pending == 0) {
+                m_ready.push_back(id);
+            }
+        }
+
+        m_begin = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> workers;
+        for (std::uint32_t i = 1; i < m_threadCount; i++) {
+            workers.emplace_back([this, i] { work(i); });
+        }
+
+        work(0);
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        m_elapsedMs = millisecondsSince(m_begin);
+
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+    // Logs when each task ran, and on which thread, relative to the start of
+    // run()
+    void printTimeline(const char* title) const
+    {
+        const int width = 40;
+
+        Log::print("%s took %.3f ms on %u threads\n", title, m_elapsedMs,
+            m_threadCount);
+
+        for (const auto& task : m_tasks) {
+            if (!task.ran) {
+                Log::print("  %-16s skipped\n", task.name.c_str());
+                continue;
+            }
+
+            const auto column = [&](double ms) {
+                return m_elapsedMs > 0.0
+                    ? static_cast<int>(ms / m_elapsedMs * width)
+                    : 0;
+            };
+
+            const auto first = std::min(column(task.beginMs), width - 1);
+            const auto last
+                = std::max(std::min(column(task.endMs), width), first + 1);
+
+            const std::string bar = std::string(first, ' ')
+                + std::string(last - first, '#')
+                + std::string(width - last, ' ');
+
+            Log::print("  %-16s %9.3f %9.3f ms  thread %u  |%s|\n",
+                task.name.c_str(), task.beginMs, task.endMs, task.thread,
+                bar.c_str());
+        }
+    }
+
+private:
+    struct Task {
+        std::string name;
+        std::function<void()> work;
+        std::vector<TaskId> dependents;
+        std::uint32_t pending;
+
+        bool ran = false;
+        std::uint32_t thread = 0;
+        double beginMs = 0.0;
+        double endMs = 0.0;
+    };
+
+    static double millisecondsSince(std::chrono::steady_clock::time_point begin)
+    {
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - begin;
+        return elapsed.count();
+    }
+
+    void work(std::uint32_t thread)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (true) {
+            m_changed.wait(
+                lock, [this] { return !m_ready.empty() || m_remaining == 0; });
+
+            if (m_ready.empty()) {
+                return;
+            }
+
+            const auto id = m_ready.back();
+            m_ready.pop_back();
+            auto& task = m_tasks[id];
+
+            bool failed = m_error != nullptr;
+
+            if (!failed) {
+                lock.unlock();
+
+                const auto beginMs = millisecondsSince(m_begin);
+                std::exception_ptr error;
+
+                try {
+                    task.work();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+
+                const auto endMs = millisecondsSince(m_begin);
+
+                lock.lock();
+
+                task.ran = true;
+                task.thread = thread;
+                task.beginMs = beginMs;
+                task.endMs = endMs;
+
+                if (error) {
+                    failed = true;
+
+                    if (!m_error) {
+                        m_error = error;
+                    }
+                }
+            }
+
+            finish(id, failed);
+            m_changed.notify_all();
+        }
+    }
+
+    // Counts the task as done and releases its dependents, or skips them
+    // when it failed. Called with the mutex locked.
+    void finish(TaskId id, bool failed)
+    {
+        m_remaining--;
+
+        for (const auto dependent : m_tasks[id].dependents) {
+            if (--m_tasks[dependent].pending != 0) {
+                continue;
+            }
+
+            if (failed) {
+                finish(dependent, true);
+            } else {
+                m_ready.push_back(dependent);
+            }
+        }
+    }
+
+    std::vector<Task> m_tasks;
+    std::uint32_t m_threadCount = 1;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<TaskId> m_ready;
+    std::size_t m_remaining = 0;
+    std::exception_ptr m_error;
+
+    std::chrono::steady_clock::time_point m_begin;
+    double m_elapsedMs = 0.0;
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "glm/mat4x4.hpp"
+
+#include "WorkerThreads.hpp"
+
+// Local and world matrices of a forest of nodes.
+//
+// The matrices are stored in arrays ordered by depth, breadth first, so
+// that parents come before their children and the children of a node are
+// next to each other. update() only recomputes the nodes whose local matrix
+// changed and their descendants, one depth level at a time, with large
+// levels split across threads.
+//
+// Nodes keep the index they were added with. Adding nodes reorders the
+// arrays on the next update(), which is meant to be rare.
+class TransformHierarchy {
+public:
+    using Node = std::uint32_t;
+
+    // Parent of the root nodes
+    static constexpr Node none = ~Node{ 0 };
+
+    std::size_t size() const { return m_slots.size(); }
+
+    // Adds a node under parent, which must have been added before, or a
+    // root node under none. Returns its index, which is the number of nodes
+    // added before it.
+    Node add(Node parent, const glm::mat4& local = glm::mat4(1.0f))
+    {
+        const auto node = static_cast<Node>(m_slots.size());
+        const auto slot = static_cast<std::uint32_t>(m_nodes.size());
+
+        m_slots.push_back(slot);
+        m_nodes.push_back(node);
+        m_parents.push_back(parent);
+        if (parent != none) {
+            m_parents.back() = m_slots.at(parent);
+        }
+        m_local.push_back(local);
+        m_world.push_back(local);
+        m_dirty.push_back(1);
+        m_dirtyNodes.push_back(node);
+        m_sorted = false;
+
+        return node;
+    }
+
+    void setLocal(Node node, const glm::mat4& local)
+    {
+        const auto slot = m_slots.at(node);
+
+        m_local[slot] = local;
+
+        if (!m_dirty[slot]) {
+            m_dirty[slot] = 1;
+            m_dirtyNodes.push_back(node);
+        }
+    }
+
+    const glm::mat4& local(Node node) const
+    {
+        return m_local[m_slots.at(node)];
+    }
+
+    // As of the last update()
+    const glm::mat4& world(Node node) const
+    {
+        return m_world[m_slots.at(node)];
+    }
+
+    // Recomputes the world matrices that changed since the last update and
+    // returns how many did. When output isn't null, each recomputed matrix
+    // is also written to output + node * stride, e.g. into a mapped buffer.
+    // The others are left as they are, so output must still hold the
+    // matrices of the previous update.
+    std::size_t update(WorkerThreads& threads, void* output = nullptr,
+        std::size_t stride = sizeof(glm::mat4))
+    {
+        if (!m_sorted) {
+            sort();
+        }
+
+        // Nodes set since the last update, by level
+        for (auto& level : m_dirtyLevels) {
+            level.clear();
+        }
+
+        for (const auto node : m_dirtyNodes) {
+            const auto slot = m_slots[node];
+            m_dirtyLevels[m_depths[slot]].push_back(slot);
+        }
+
+        m_dirtyNodes.clear();
+
+        std::size_t updated = 0;
+        m_current.clear();
+
+        for (const auto& dirty : m_dirtyLevels) {
+            // The nodes set at this level, and the children of the nodes
+            // updated at the level above that weren't set themselves
+            m_next.assign(dirty.begin(), dirty.end());
+
+            for (const auto parent : m_current) {
+                const auto first = m_firstChildren[parent];
+                const auto last = first + m_childCounts[parent];
+
+                for (auto child = first; child < last; child++) {
+                    if (!m_dirty[child]) {
+                        m_next.push_back(child);
+                    }
+                }
+            }
+
+            std::swap(m_current, m_next);
+
+            if (m_current.empty()) {
+                continue;
+            }
+
+            const auto count = static_cast<std::uint32_t>(m_current.size());
+            const auto partCount = std::max(
+                std::min(threads.threadCount(), count / minPartSize), 1u);
+
+            threads.run(partCount, [&](std::uint32_t part) {
+                const auto first = static_cast<std::uint32_t>(
+                    std::uint64_t{ count } * part / partCount);
+                const auto last = static_cast<std::uint32_t>(
+                    std::uint64_t{ count } * (part + 1) / partCount);
+
+                for (auto i = first; i < last; i++) {
+                    updateSlot(m_current[i], output, stride);
+                }
+            });
+
+            updated += m_current.size();
+        }
+
+        return updated;
+    }
+
+private:
+    // Fewer nodes than this per thread aren't worth a thread
+    static constexpr std::uint32_t minPartSize = 1024;
+
+    void updateSlot(std::uint32_t slot, void* output, std::size_t stride)
+    {
+        const auto parent = m_parents[slot];
+
+        m_world[slot] = parent == none ? m_local[slot]
+                                       : m_world[parent] * m_local[slot];
+        m_dirty[slot] = 0;
+
+        if (output != nullptr) {
+            std::memcpy(static_cast<char*>(output) + m_nodes[slot] * stride,
+                &m_world[slot], sizeof(glm::mat4));
+        }
+    }
+
+    // Reorders the arrays breadth first, from the nodes in the order they
+    // were added. A parent is always added before its children, so it is
+    // already placed when its children are.
+    void sort()
+    {
+        const auto count = static_cast<std::uint32_t>(m_slots.size());
+
+        // Children of each node, in the order they were added
+        std::vector<std::uint32_t> childOffsets(count + 1, 0);
+        std::vector<Node> parentNodes(count);
+
+        for (Node node = 0; node < count; node++) {
+            const auto parentSlot = m_parents[m_slots[node]];
+            parentNodes[node]
+                = parentSlot == none ? none : m_nodes[parentSlot];
+
+            if (parentNodes[node] != none) {
+                childOffsets[parentNodes[node] + 1]++;
+            }
+        }
+
+        for (Node node = 0; node < count; node++) {
+            childOffsets[node + 1] += childOffsets[node];
+        }
+
+        std::vector<Node> children(childOffsets[count]);
+        std::vector<std::uint32_t> filled(childOffsets.begin(),
+            childOffsets.end() - 1);
+
+        for (Node node = 0; node < count; node++) {
+            if (parentNodes[node] != none) {
+                children[filled[parentNodes[node]]++] = node;
+            }
+        }
+
+        // Breadth first: the roots, then the children of each placed node
+        std::vector<Node> order;
+        order.reserve(count);
+
+        for (Node node = 0; node < count; node++) {
+            if (parentNodes[node] == none) {
+                order.push_back(node);
+            }
+        }
+
+        std::vector<std::uint32_t> depths(count, 0);
+
+        for (std::size_t i = 0; i < order.size(); i++) {
+            const auto node = order[i];
+
+            for (auto c = childOffsets[node]; c < childOffsets[node + 1];
+                 c++) {
+                depths[children[c]] = depths[node] + 1;
+                order.push_back(children[c]);
+            }
+        }
+
+        // Permute the per-slot arrays into the new order
+        std::vector<glm::mat4> local(count);
+        std::vector<glm::mat4> world(count);
+        std::vector<std::uint8_t> dirty(count);
+
+        for (std::uint32_t slot = 0; slot < count; slot++) {
+            const auto oldSlot = m_slots[order[slot]];
+
+            local[slot] = m_local[oldSlot];
+            world[slot] = m_world[oldSlot];
+            dirty[slot] = m_dirty[oldSlot];
+        }
+
+        m_local = std::move(local);
+        m_world = std::move(world);
+        m_dirty = std::move(dirty);
+        m_nodes = std::move(order);
+
+        for (std::uint32_t slot = 0; slot < count; slot++) {
+            m_slots[m_nodes[slot]] = slot;
+        }
+
+        m_depths.resize(count);
+        m_firstChildren.resize(count);
+        m_childCounts.resize(count);
+
+        std::uint32_t levelCount = 0;
+
+        for (std::uint32_t slot = 0; slot < count; slot++) {
+            const auto node = m_nodes[slot];
+
+            m_parents[slot] = parentNodes[node] == none
+                ? none
+                : m_slots[parentNodes[node]];
+            m_depths[slot] = depths[node];
+            m_childCounts[slot] = childOffsets[node + 1] - childOffsets[node];
+            m_firstChildren[slot] = m_childCounts[slot] != 0
+                ? m_slots[children[childOffsets[node]]]
+                : 0;
+
+            levelCount = std::max(levelCount, depths[node] + 1);
+        }
+
+        m_dirtyLevels.resize(levelCount);
+        m_sorted = true;
+    }
+
+    // Slot of each node
+    std::vector<std::uint32_t> m_slots;
+
+    // Per slot
+    std::vector<Node> m_nodes;
+    std::vector<std::uint32_t> m_parents;
+    std::vector<std::uint32_t> m_depths;
+    std::vector<std::uint32_t> m_firstChildren;
+    std::vector<std::uint32_t> m_childCounts;
+    std::vector<glm::mat4> m_local;
+    std::vector<glm::mat4> m_world;
+    std::vector<std::uint8_t> m_dirty;
+
+    std::vector<Node> m_dirtyNodes;
+    // Slots set since the last update, by depth
+    std::vector<std::vector<std::uint32_t>> m_dirtyLevels;
+    bool m_sorted = true;
+
+    // Slots updated at the current level, and being gathered for the next
+    std::vector<std::uint32_t> m_current;
+    std::vector<std::uint32_t> m_next;
+};
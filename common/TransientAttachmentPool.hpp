@@ -0,0 +1,283 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "DeletionQueue.hpp"
+#include "MemoryAllocator.hpp"
+
+// Attachments whose contents only live within a frame's passes, such as
+// depth buffers that are cleared on load and not stored.
+//
+// Images only used as attachments are created transient and bound to lazily
+// allocated memory where the device has it, which tiled GPUs may never back
+// with memory at all. Elsewhere, attachments used by passes that don't
+// overlap share device-local memory, so an attachment's contents are
+// undefined at the start of its first pass.
+//
+// Attachments are added, then allocated together, and cleared together when
+// they have to be recreated, e.g. at a new size. With a deletion queue,
+// clearing retires them to it, so the GPU may still be using them.
+class TransientAttachmentPool {
+public:
+    using Attachment = std::uint32_t;
+
+    struct Report {
+        std::uint32_t attachmentCount = 0;
+        // What the attachments would take with an allocation each
+        vk::DeviceSize requiredBytes = 0;
+        // What was allocated for them once aliased
+        vk::DeviceSize allocatedBytes = 0;
+        // The part of allocatedBytes that is lazily allocated
+        vk::DeviceSize lazyBytes = 0;
+    };
+
+    TransientAttachmentPool(const vk::Device& device,
+        MemoryAllocator& allocator, DeletionQueue* deletionQueue = nullptr)
+        : m_device(device)
+        , m_allocator(allocator)
+        , m_deletionQueue(deletionQueue)
+    {
+    }
+
+    TransientAttachmentPool(const TransientAttachmentPool&) = delete;
+    TransientAttachmentPool& operator=(const TransientAttachmentPool&)
+        = delete;
+
+    ~TransientAttachmentPool() { clear(); }
+
+    // Memory requirements of an attachment, found without keeping one
+    static vk::MemoryRequirements requirements(const vk::Device& device,
+        vk::Format format, const vk::Extent2D& extent,
+        const vk::ImageUsageFlags& usage)
+    {
+        const auto image
+            = device.createImage(imageCreateInfo(format, extent, usage));
+        const auto requirements = device.getImageMemoryRequirements(image);
+        device.destroyImage(image);
+
+        return requirements;
+    }
+
+    // Whether one of the memory types allowed by typeBits is lazily
+    // allocated
+    static bool hasLazyMemory(
+        const vk::PhysicalDeviceMemoryProperties& memoryProps,
+        std::uint32_t typeBits)
+    {
+        for (std::uint32_t i = 0; i < memoryProps.memoryTypeCount; i++) {
+            if ((typeBits & (1u << i))
+                && (memoryProps.memoryTypes[i].propertyFlags
+                    & vk::MemoryPropertyFlagBits::eLazilyAllocated)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Adds an attachment used by the passes [firstPass, lastPass] of a
+    // frame, by default all of them. Its memory is bound by allocate().
+    Attachment add(vk::Format format, const vk::Extent2D& extent,
+        const vk::ImageUsageFlags& usage,
+        const vk::ImageAspectFlags& aspect, std::uint32_t firstPass = 0,
+        std::uint32_t lastPass = ~0u)
+    {
+        m_entries.push_back({ m_device.createImage(
+                                  imageCreateInfo(format, extent, usage)),
+            {}, format, aspect, firstPass, lastPass });
+
+        return static_cast<Attachment>(m_entries.size() - 1);
+    }
+
+    // Binds memory to the attachments added since the last allocate() and
+    // creates their views
+    void allocate()
+    {
+        // Attachments in the order their first pass starts. Each joins the
+        // first group whose attachments are all done by then.
+        std::vector<Attachment> order(m_entries.size() - m_allocatedCount);
+        std::iota(order.begin(), order.end(), m_allocatedCount);
+        std::stable_sort(order.begin(), order.end(),
+            [this](Attachment a, Attachment b) {
+                return m_entries[a].firstPass < m_entries[b].firstPass;
+            });
+
+        struct Group {
+            vk::MemoryRequirements requirements;
+            bool lazy;
+            std::uint32_t lastPass;
+            std::vector<Attachment> attachments;
+        };
+
+        std::vector<Group> groups;
+
+        for (const auto attachment : order) {
+            const auto& entry = m_entries[attachment];
+            const auto requirements
+                = m_device.getImageMemoryRequirements(entry.image);
+            const auto lazy = hasLazyMemory(
+                m_allocator.memoryProperties(), requirements.memoryTypeBits);
+
+            m_report.attachmentCount++;
+            m_report.requiredBytes += requirements.size;
+
+            // Lazily allocated memory costs nothing to keep apart
+            const auto group = lazy
+                ? groups.end()
+                : std::find_if(groups.begin(), groups.end(),
+                      [&](const Group& group) {
+                          return !group.lazy
+                              && group.lastPass < entry.firstPass
+                              && (group.requirements.memoryTypeBits
+                                     & requirements.memoryTypeBits);
+                      });
+
+            if (group == groups.end()) {
+                groups.push_back(
+                    { requirements, lazy, entry.lastPass, { attachment } });
+                continue;
+            }
+
+            group->requirements.size
+                = std::max(group->requirements.size, requirements.size);
+            group->requirements.alignment = std::max(
+                group->requirements.alignment, requirements.alignment);
+            group->requirements.memoryTypeBits &= requirements.memoryTypeBits;
+            group->lastPass = std::max(group->lastPass, entry.lastPass);
+            group->attachments.push_back(attachment);
+        }
+
+        for (const auto& group : groups) {
+            const auto allocation = m_allocator.allocate(group.requirements,
+                group.lazy ? vk::MemoryPropertyFlagBits::eDeviceLocal
+                        | vk::MemoryPropertyFlagBits::eLazilyAllocated
+                           : vk::MemoryPropertyFlagBits::eDeviceLocal,
+                true);
+
+            for (const auto attachment : group.attachments) {
+                m_device.bindImageMemory(m_entries[attachment].image,
+                    allocation.memory, allocation.offset);
+            }
+
+            m_allocations.push_back(allocation);
+            m_report.allocatedBytes += group.requirements.size;
+            if (group.lazy) {
+                m_report.lazyBytes += group.requirements.size;
+            }
+        }
+
+        for (auto i = m_allocatedCount; i < m_entries.size(); i++) {
+            auto& entry = m_entries[i];
+
+            entry.view = m_device.createImageView({ {}, entry.image,
+                vk::ImageViewType::e2D, entry.format, {},
+                { entry.aspect, 0, 1, 0, 1 } });
+        }
+
+        m_allocatedCount = m_entries.size();
+    }
+
+    const vk::Image& image(Attachment attachment) const
+    {
+        return m_entries.at(attachment).image;
+    }
+
+    const vk::ImageView& view(Attachment attachment) const
+    {
+        return m_entries.at(attachment).view;
+    }
+
+    const Report& report() const { return m_report; }
+
+    // Destroys every attachment and frees its memory. Without a deletion
+    // queue, the GPU must be done with them.
+    void clear()
+    {
+        for (const auto& entry : m_entries) {
+            if (entry.view) {
+                dispose(entry.view);
+            }
+            dispose(entry.image);
+        }
+
+        for (const auto& allocation : m_allocations) {
+            dispose(allocation);
+        }
+
+        m_entries.clear();
+        m_allocations.clear();
+        m_allocatedCount = 0;
+        m_report = Report{};
+    }
+
+private:
+    struct Entry {
+        vk::Image image;
+        vk::ImageView view;
+        vk::Format format;
+        vk::ImageAspectFlags aspect;
+        std::uint32_t firstPass;
+        std::uint32_t lastPass;
+    };
+
+    // Transient images may only be used as attachments. Those also sampled
+    // or stored to, e.g. by a post-process pass, are ordinary images.
+    static vk::ImageCreateInfo imageCreateInfo(vk::Format format,
+        const vk::Extent2D& extent, const vk::ImageUsageFlags& usage)
+    {
+        const vk::ImageUsageFlags attachmentUsage
+            = vk::ImageUsageFlagBits::eColorAttachment
+            | vk::ImageUsageFlagBits::eDepthStencilAttachment
+            | vk::ImageUsageFlagBits::eInputAttachment;
+        const auto transient = !(usage & ~attachmentUsage);
+
+        return { {}, vk::ImageType::e2D, format,
+            { extent.width, extent.height, 1 }, 1, 1,
+            vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal,
+            transient ? usage | vk::ImageUsageFlagBits::eTransientAttachment
+                      : usage,
+            vk::SharingMode::eExclusive, 0, nullptr,
+            vk::ImageLayout::eUndefined };
+    }
+
+    void dispose(const vk::ImageView& view)
+    {
+        if (m_deletionQueue != nullptr) {
+            m_deletionQueue->retire(view);
+        } else {
+            m_device.destroyImageView(view);
+        }
+    }
+
+    void dispose(const vk::Image& image)
+    {
+        if (m_deletionQueue != nullptr) {
+            m_deletionQueue->retire(image);
+        } else {
+            m_device.destroyImage(image);
+        }
+    }
+
+    void dispose(const MemoryAllocator::Allocation& allocation)
+    {
+        if (m_deletionQueue != nullptr) {
+            m_deletionQueue->retire(allocation);
+        } else {
+            m_allocator.free(allocation);
+        }
+    }
+
+    vk::Device m_device;
+    MemoryAllocator& m_allocator;
+    DeletionQueue* m_deletionQueue;
+
+    std::vector<Entry> m_entries;
+    std::size_t m_allocatedCount = 0;
+    std::vector<MemoryAllocator::Allocation> m_allocations;
+    Report m_report;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands values from one writer thread to one reader thread without locks
+// or waiting on either side.
+//
+// The writer fills the back buffer and publishes it, swapping it with the
+// middle one. The reader takes the middle buffer whenever a newer one was
+// published, swapping it with the front one. Neither ever touches the
+// buffer the other holds, and the reader always sees the latest complete
+// value, skipping those published in between.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+
+    explicit TripleBuffer(const T& initial)
+        : m_buffers{ initial, initial, initial }
+    {
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer: the buffer to fill before publish()
+    T& back() { return m_buffers[m_back]; }
+
+    // Writer: makes the back buffer the latest value
+    void publish()
+    {
+        m_back = m_middle.exchange(m_back | dirty, std::memory_order_acq_rel)
+            & index;
+    }
+
+    // Reader: the latest published value, which stays valid until the next
+    // call
+    const T& read()
+    {
+        if (m_middle.load(std::memory_order_relaxed) & dirty) {
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel)
+                & index;
+        }
+
+        return m_buffers[m_front];
+    }
+
+private:
+    // The middle index holds whether it was published since the last read
+    static constexpr std::uint8_t index = 0x3;
+    static constexpr std::uint8_t dirty = 0x4;
+
+    T m_buffers[3];
+    std::uint8_t m_front = 0;
+    std::atomic<std::uint8_t> m_middle{ 1 };
+    std::uint8_t m_back = 2;
+};
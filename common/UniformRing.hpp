@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+#include "MemoryAllocator.hpp"
+#include "StreamBuffer.hpp"
+
+// A stream buffer of uniform data. Each frame pushes its uniform data into
+// its own region and binds it with a dynamic offset, so the CPU never writes
+// memory the GPU may still be reading.
+class UniformRing {
+public:
+    UniformRing(const vk::Device& device, MemoryAllocator& allocator,
+        vk::DeviceSize alignment, vk::DeviceSize regionSize,
+        std::uint32_t regionCount)
+        : m_stream(device, allocator, vk::BufferUsageFlagBits::eUniformBuffer,
+              alignment, regionSize, regionCount)
+    {
+    }
+
+    const vk::Buffer& buffer() const { return m_stream.buffer(); }
+
+    // Starts writing into the region of the given frame. The caller must have
+    // waited for the frame's previous submission to complete.
+    void beginFrame(std::uint32_t regionIndex)
+    {
+        m_stream.beginFrame(regionIndex);
+    }
+
+    // Copies the data into the current region and returns the dynamic offset
+    // to bind it with
+    template <typename T> std::uint32_t push(const T& data)
+    {
+        const auto range = m_stream.reserve(sizeof(T));
+        std::memcpy(range.data, &data, sizeof(T));
+
+        return static_cast<std::uint32_t>(range.offset);
+    }
+
+private:
+    StreamBuffer m_stream;
+};
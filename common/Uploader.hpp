@@ -0,0 +1,311 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "MemoryAllocator.hpp"
+
+// Copies data into device-local buffers through a persistently mapped staging
+// ring.
+//
+// Uploads are recorded into a batch and submitted together by flush(), so
+// many small uploads share one submission. Each batch owns a slot of the
+// staging ring that is reclaimed once its fence signals; an upload larger
+// than the free space is split into chunks and earlier batches are
+// submitted as needed. The queue is preferably a dedicated transfer queue,
+// in which case destination buffers are shared concurrently with the
+// graphics queue family.
+class Uploader {
+public:
+    struct Buffer {
+        vk::Buffer buffer;
+        MemoryAllocator::Allocation allocation;
+    };
+
+    Uploader(const vk::Device& device, MemoryAllocator& allocator,
+        const vk::Queue& queue, std::uint32_t queueFamilyIndex,
+        std::uint32_t graphicsQueueFamilyIndex,
+        vk::DeviceSize stagingSize = 16 * 1024 * 1024,
+        std::uint32_t batchCount = 4)
+        : m_device(device)
+        , m_allocator(allocator)
+        , m_queue(queue)
+        , m_queueFamilyIndices{ { queueFamilyIndex, graphicsQueueFamilyIndex } }
+        , m_stagingSize(stagingSize)
+        , m_batches(batchCount)
+    {
+        m_stagingBuffer = m_device.createBuffer({ {}, m_stagingSize,
+            vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive,
+            0, nullptr });
+        m_staging = m_allocator.allocateBuffer(m_stagingBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible
+                | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+        m_commandPool = m_device.createCommandPool(
+            { vk::CommandPoolCreateFlagBits::eTransient
+                    | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                queueFamilyIndex });
+
+        const auto commandBuffers = m_device.allocateCommandBuffers(
+            { m_commandPool, vk::CommandBufferLevel::ePrimary, batchCount });
+
+        for (std::uint32_t i = 0; i < batchCount; i++) {
+            auto& batch = m_batches.at(i);
+            batch.commandBuffer = commandBuffers.at(i);
+            batch.fence = m_device.createFence({});
+            batch.semaphore = m_device.createSemaphore({});
+        }
+    }
+
+    Uploader(const Uploader&) = delete;
+    Uploader& operator=(const Uploader&) = delete;
+
+    ~Uploader()
+    {
+        waitIdle();
+
+        for (const auto& batch : m_batches) {
+            m_device.destroySemaphore(batch.semaphore);
+            m_device.destroyFence(batch.fence);
+        }
+
+        m_device.destroyCommandPool(m_commandPool);
+        m_device.destroyBuffer(m_stagingBuffer);
+        m_allocator.free(m_staging);
+    }
+
+    // Creates a device-local buffer that can be the destination of uploads
+    Buffer createBuffer(vk::DeviceSize size, const vk::BufferUsageFlags& usage)
+    {
+        const bool concurrent
+            = m_queueFamilyIndices.at(0) != m_queueFamilyIndices.at(1);
+
+        Buffer buffer;
+        buffer.buffer = m_device.createBuffer({ {}, size,
+            usage | vk::BufferUsageFlagBits::eTransferDst,
+            concurrent ? vk::SharingMode::eConcurrent
+                       : vk::SharingMode::eExclusive,
+            concurrent ? static_cast<std::uint32_t>(m_queueFamilyIndices.size())
+                       : 0,
+            concurrent ? m_queueFamilyIndices.data() : nullptr });
+        buffer.allocation = m_allocator.allocateBuffer(
+            buffer.buffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        return buffer;
+    }
+
+    void destroyBuffer(const Buffer& buffer)
+    {
+        m_device.destroyBuffer(buffer.buffer);
+        m_allocator.free(buffer.allocation);
+    }
+
+    // Records a copy of size bytes of data into dst at dstOffset. The data is
+    // copied into the staging ring before this returns.
+    void upload(const vk::Buffer& dst, vk::DeviceSize dstOffset,
+        const void* data, vk::DeviceSize size)
+    {
+        auto src = static_cast<const char*>(data);
+
+        while (size > 0) {
+            const auto chunk = reserve(size);
+
+            std::memcpy(m_staging.mapped + chunk.offset, src, chunk.size);
+
+            const vk::BufferCopy region{ chunk.offset, dstOffset, chunk.size };
+            m_batches.at(m_current).commandBuffer.copyBuffer(
+                m_stagingBuffer, dst, region);
+
+            src += chunk.size;
+            dstOffset += chunk.size;
+            size -= chunk.size;
+        }
+    }
+
+    // Submits the uploads recorded since the last flush. The returned
+    // semaphore is signaled once they and everything flushed earlier have
+    // completed, and must be waited on by the next submission that reads the
+    // uploaded data. Returns a null handle when nothing was recorded.
+    vk::Semaphore flush()
+    {
+        if (m_batches.at(m_current).recording) {
+            submit();
+        }
+
+        const auto semaphore = m_chainSemaphore;
+        m_chainSemaphore = vk::Semaphore{};
+
+        return semaphore;
+    }
+
+    // Blocks until every submitted batch has completed
+    void waitIdle()
+    {
+        while (!m_pending.empty()) {
+            retireOldest();
+        }
+    }
+
+private:
+    struct Batch {
+        vk::CommandBuffer commandBuffer;
+        vk::Fence fence;
+        vk::Semaphore semaphore;
+        // Ring offset just past the batch's last byte
+        vk::DeviceSize end = 0;
+        // Bytes of the ring the batch holds, including padding
+        vk::DeviceSize consumed = 0;
+        bool recording = false;
+        bool pending = false;
+    };
+
+    struct Chunk {
+        vk::DeviceSize offset;
+        vk::DeviceSize size;
+    };
+
+    static vk::DeviceSize alignUp(vk::DeviceSize offset, vk::DeviceSize alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    Batch& currentBatch()
+    {
+        auto& batch = m_batches.at(m_current);
+
+        if (batch.recording) {
+            return batch;
+        }
+
+        // Slots are reused in submission order
+        while (batch.pending) {
+            retireOldest();
+        }
+
+        m_device.resetFences({ batch.fence });
+        batch.commandBuffer.reset({});
+        batch.commandBuffer.begin(
+            { vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr });
+        batch.end = m_head;
+        batch.consumed = 0;
+        batch.recording = true;
+
+        return batch;
+    }
+
+    // Reserves up to size contiguous bytes of the ring for the current batch
+    Chunk reserve(vk::DeviceSize size)
+    {
+        while (true) {
+            auto& batch = currentBatch();
+
+            if (m_used == 0) {
+                m_head = 0;
+                m_tail = 0;
+            }
+
+            const auto offset = alignUp(m_head, 16);
+
+            vk::DeviceSize available = 0;
+            if (m_used == 0 || m_head > m_tail) {
+                available = m_stagingSize > offset ? m_stagingSize - offset : 0;
+            } else if (m_tail > offset) {
+                available = m_tail - offset;
+            }
+
+            if (available > 0) {
+                const auto chunkSize = std::min(size, available);
+                const auto consumed = offset + chunkSize - m_head;
+
+                batch.consumed += consumed;
+                m_used += consumed;
+                m_head = offset + chunkSize;
+                batch.end = m_head;
+
+                return { offset, chunkSize };
+            }
+
+            if (m_head > m_tail) {
+                // The end of the ring is used up; wrap around to the start
+                const auto skipped = m_stagingSize - m_head;
+
+                batch.consumed += skipped;
+                m_used += skipped;
+                m_head = 0;
+                batch.end = 0;
+            } else if (!m_pending.empty()) {
+                retireOldest();
+            } else {
+                // The current batch fills the whole ring
+                submit();
+            }
+        }
+    }
+
+    void submit()
+    {
+        auto& batch = m_batches.at(m_current);
+
+        batch.commandBuffer.end();
+
+        // A batch submitted earlier without being flushed is chained in, so
+        // that the flushed semaphore covers it too
+        const vk::PipelineStageFlags waitDstStageMask
+            = vk::PipelineStageFlagBits::eTransfer;
+        const std::uint32_t waitCount = m_chainSemaphore ? 1 : 0;
+
+        m_queue.submit({ { waitCount, &m_chainSemaphore, &waitDstStageMask, 1,
+                           &batch.commandBuffer, 1, &batch.semaphore } },
+            batch.fence);
+
+        m_chainSemaphore = batch.semaphore;
+
+        batch.recording = false;
+        batch.pending = true;
+        m_pending.push_back(m_current);
+        m_current = static_cast<std::uint32_t>(
+            (m_current + 1) % m_batches.size());
+    }
+
+    void retireOldest()
+    {
+        auto& batch = m_batches.at(m_pending.front());
+        m_pending.pop_front();
+
+        m_device.waitForFences({ batch.fence }, VK_TRUE, UINT64_MAX);
+
+        batch.pending = false;
+        m_tail = batch.end;
+        m_used -= batch.consumed;
+    }
+
+    vk::Device m_device;
+    MemoryAllocator& m_allocator;
+    vk::Queue m_queue;
+    // The upload queue family followed by the graphics queue family
+    std::array<std::uint32_t, 2> m_queueFamilyIndices;
+
+    vk::DeviceSize m_stagingSize;
+    vk::Buffer m_stagingBuffer;
+    MemoryAllocator::Allocation m_staging;
+
+    // Bytes of the ring between the tail and the head that belong to
+    // recording or pending batches
+    vk::DeviceSize m_head = 0;
+    vk::DeviceSize m_tail = 0;
+    vk::DeviceSize m_used = 0;
+
+    vk::CommandPool m_commandPool;
+    std::vector<Batch> m_batches;
+    std::uint32_t m_current = 0;
+    // Submitted batches, oldest first
+    std::deque<std::uint32_t> m_pending;
+    // Signaled by the last submitted batch and not yet waited on
+    vk::Semaphore m_chainSemaphore;
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Compact vertex attribute types, and vertex input descriptions generated
+// from the vertex struct that uses them.
+//
+// A vertex is a plain struct of attribute types. Its attribute descriptions
+// come from the types and offsets of the members, so they can't drift from
+// the struct:
+//
+//   struct Vertex {
+//       Snorm16x4 position;
+//       Unorm8x4 color;
+//   };
+//
+//   const auto attributes = VertexFormat::attributes(
+//       0, 0, &Vertex::position, &Vertex::color);
+
+// Four components in [-1, 1], read by shaders as floats. A position in the
+// unit cube keeps 15 bits of precision per axis at a quarter of the size of
+// floats.
+struct Snorm16x4 {
+    std::int16_t values[4];
+
+    static Snorm16x4 pack(float x, float y, float z, float w)
+    {
+        return { { packComponent(x), packComponent(y), packComponent(z),
+            packComponent(w) } };
+    }
+
+private:
+    static std::int16_t packComponent(float value)
+    {
+        const auto clamped = std::max(-1.0f, std::min(value, 1.0f));
+        return static_cast<std::int16_t>(std::lround(clamped * 32767.0f));
+    }
+};
+
+// Four components in [0, 1], read by shaders as floats. Enough for colors.
+struct Unorm8x4 {
+    std::uint8_t values[4];
+
+    static Unorm8x4 pack(float r, float g, float b, float a)
+    {
+        return { { packComponent(r), packComponent(g), packComponent(b),
+            packComponent(a) } };
+    }
+
+private:
+    static std::uint8_t packComponent(float value)
+    {
+        const auto clamped = std::max(0.0f, std::min(value, 1.0f));
+        return static_cast<std::uint8_t>(std::lround(clamped * 255.0f));
+    }
+};
+
+// The vertex format of an attribute type, as value. Specialize it for other
+// types used as attributes, such as math library vectors.
+template <typename T> struct VertexAttributeFormat;
+
+template <>
+struct VertexAttributeFormat<Snorm16x4>
+    : std::integral_constant<vk::Format, vk::Format::eR16G16B16A16Snorm> {
+};
+
+template <>
+struct VertexAttributeFormat<Unorm8x4>
+    : std::integral_constant<vk::Format, vk::Format::eR8G8B8A8Unorm> {
+};
+
+template <>
+struct VertexAttributeFormat<float>
+    : std::integral_constant<vk::Format, vk::Format::eR32Sfloat> {
+};
+
+template <>
+struct VertexAttributeFormat<float[2]>
+    : std::integral_constant<vk::Format, vk::Format::eR32G32Sfloat> {
+};
+
+template <>
+struct VertexAttributeFormat<float[3]>
+    : std::integral_constant<vk::Format, vk::Format::eR32G32B32Sfloat> {
+};
+
+template <>
+struct VertexAttributeFormat<float[4]>
+    : std::integral_constant<vk::Format, vk::Format::eR32G32B32A32Sfloat> {
+};
+
+namespace VertexFormat {
+
+// Describes the given members of Vertex as consecutive shader locations,
+// starting at firstLocation, read from binding
+template <typename Vertex, typename... Attributes>
+std::array<vk::VertexInputAttributeDescription, sizeof...(Attributes)>
+attributes(std::uint32_t binding, std::uint32_t firstLocation,
+    Attributes Vertex::*... members)
+{
+    static_assert(std::is_standard_layout<Vertex>::value,
+        "Vertex must be a standard layout struct");
+
+    const Vertex vertex{};
+    const auto base = reinterpret_cast<const char*>(&vertex);
+
+    std::uint32_t location = firstLocation;
+
+    return { { { location++, binding,
+        VertexAttributeFormat<Attributes>::value,
+        static_cast<std::uint32_t>(
+            reinterpret_cast<const char*>(&(vertex.*members)) - base) }... } };
+}
+
+// Triangle indices stored with the smallest index type that can address
+// every vertex
+struct Indices {
+    vk::IndexType type;
+    std::uint32_t count;
+    std::vector<char> data;
+};
+
+inline Indices packIndices(
+    const std::vector<std::uint32_t>& indices, std::size_t vertexCount)
+{
+    Indices packed{ vk::IndexType::eUint32,
+        static_cast<std::uint32_t>(indices.size()), {} };
+
+    // 0xFFFF is left out as it restarts primitives when that is enabled
+    if (vertexCount <= 0xFFFF) {
+        packed.type = vk::IndexType::eUint16;
+        packed.data.resize(indices.size() * sizeof(std::uint16_t));
+
+        auto output = reinterpret_cast<std::uint16_t*>(packed.data.data());
+        for (const auto index : indices) {
+            *output++ = static_cast<std::uint16_t>(index);
+        }
+    } else {
+        packed.data.resize(indices.size() * sizeof(std::uint32_t));
+        std::memcpy(packed.data.data(), indices.data(), packed.data.size());
+    }
+
+    return packed;
+}
+
+} // namespace VertexFormat
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <windows.h>
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "FrameLimiter.hpp"
+#include "PlatformConfig.hpp"
+
+// A window with a Vulkan surface and a message loop that blocks while there
+// is nothing to draw, instead of spinning on PeekMessage.
+class Win32Platform {
+public:
+    explicit Win32Platform(const PlatformConfig& config)
+        : m_config(config)
+        , m_hInstance(GetModuleHandleW(nullptr))
+    {
+        const WNDCLASSW wndClass{ CS_HREDRAW | CS_VREDRAW, wndProc, 0, 0,
+            m_hInstance, nullptr, LoadCursor(nullptr, IDC_ARROW),
+            reinterpret_cast<HBRUSH>(GetStockObject(BLACK_BRUSH)), nullptr,
+            L"vulkan-playground" };
+
+        if (!RegisterClassW(&wndClass)
+            && GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
+            throw std::runtime_error("Window class registration failed");
+        }
+
+        // Size the window so that its client area matches the config
+        RECT rect{ 0, 0, static_cast<LONG>(m_config.width),
+            static_cast<LONG>(m_config.height) };
+        const DWORD style = m_config.resizable
+            ? WS_OVERLAPPEDWINDOW
+            : WS_OVERLAPPEDWINDOW ^ (WS_THICKFRAME | WS_MAXIMIZEBOX);
+        AdjustWindowRect(&rect, style, FALSE);
+
+        m_hWnd = CreateWindowW(L"vulkan-playground",
+            widen(m_config.title).c_str(), style, CW_USEDEFAULT,
+            CW_USEDEFAULT, rect.right - rect.left, rect.bottom - rect.top,
+            nullptr, nullptr, m_hInstance, this);
+
+        if (!m_hWnd) {
+            throw std::runtime_error("Window creation failed");
+        }
+
+        ShowWindow(m_hWnd, SW_SHOWDEFAULT);
+    }
+
+    Win32Platform(const Win32Platform&) = delete;
+    Win32Platform& operator=(const Win32Platform&) = delete;
+
+    ~Win32Platform()
+    {
+        if (IsWindow(m_hWnd)) {
+            SetWindowLongPtrW(m_hWnd, GWLP_USERDATA, 0);
+            DestroyWindow(m_hWnd);
+        }
+    }
+
+    static std::vector<const char*> instanceExtensions()
+    {
+        return { VK_KHR_SURFACE_EXTENSION_NAME,
+            VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+    }
+
+    vk::SurfaceKHR createSurface(const vk::Instance& instance) const
+    {
+        return instance.createWin32SurfaceKHR({ {}, m_hInstance, m_hWnd });
+    }
+
+    // Size of the client area
+    vk::Extent2D extent() const
+    {
+        RECT rect{};
+        GetClientRect(m_hWnd, &rect);
+
+        return { static_cast<std::uint32_t>(rect.right - rect.left),
+            static_cast<std::uint32_t>(rect.bottom - rect.top) };
+    }
+
+    void setTitle(const std::string& title)
+    {
+        SetWindowTextW(m_hWnd, widen(title).c_str());
+    }
+
+    // Makes LoopMode::eOnDemand draw another frame
+    void requestRedraw() { m_redraw = true; }
+
+    // Dispatches window messages and calls frame as the loop mode allows,
+    // until the window is closed or frame returns false. Nothing is drawn
+    // while the window is minimized.
+    int run(const std::function<bool()>& frame)
+    {
+        FrameLimiter limiter(m_config.loopMode == LoopMode::eLimited
+                ? m_config.maxFrameRate
+                : 0.0);
+        m_redraw = true;
+
+        while (true) {
+            MSG msg{};
+
+            while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+                if (msg.message == WM_QUIT) {
+                    return static_cast<int>(msg.wParam);
+                }
+
+                TranslateMessage(&msg);
+                DispatchMessageW(&msg);
+            }
+
+            DWORD timeout = 0;
+
+            if (IsIconic(m_hWnd)
+                || (m_config.loopMode == LoopMode::eOnDemand && !m_redraw)) {
+                timeout = INFINITE;
+            } else if (m_config.loopMode == LoopMode::eLimited) {
+                timeout = limiter.remainingMs();
+            }
+
+            if (timeout != 0) {
+                // Wakes up early when a message arrives
+                MsgWaitForMultipleObjectsEx(
+                    0, nullptr, timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+                continue;
+            }
+
+            m_redraw = false;
+            limiter.advance();
+
+            if (!frame()) {
+                return 0;
+            }
+        }
+    }
+
+private:
+    static std::wstring widen(const std::string& s)
+    {
+        if (s.empty()) {
+            return {};
+        }
+
+        const int length = MultiByteToWideChar(
+            CP_UTF8, 0, s.data(), static_cast<int>(s.size()), nullptr, 0);
+        std::wstring w(static_cast<std::size_t>(length), L'\0');
+        MultiByteToWideChar(
+            CP_UTF8, 0, s.data(), static_cast<int>(s.size()), &w[0], length);
+
+        return w;
+    }
+
+    static LRESULT CALLBACK wndProc(
+        HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) noexcept
+    {
+        if (uMsg == WM_NCCREATE) {
+            const auto createStruct = reinterpret_cast<CREATESTRUCTW*>(lParam);
+            SetWindowLongPtrW(hWnd, GWLP_USERDATA,
+                reinterpret_cast<LONG_PTR>(createStruct->lpCreateParams));
+        }
+
+        const auto self = reinterpret_cast<Win32Platform*>(
+            GetWindowLongPtrW(hWnd, GWLP_USERDATA));
+
+        switch (uMsg) {
+        case WM_DESTROY:
+            PostQuitMessage(0);
+            return 0;
+        case WM_PAINT:
+            // Drawing happens in the loop; just mark the window as drawn
+            ValidateRect(hWnd, nullptr);
+            if (self) {
+                self->m_redraw = true;
+            }
+            return 0;
+        case WM_SIZE:
+            if (self) {
+                self->m_redraw = true;
+            }
+            break;
+        }
+
+        return DefWindowProcW(hWnd, uMsg, wParam, lParam);
+    }
+
+    PlatformConfig m_config;
+    HINSTANCE m_hInstance;
+    HWND m_hWnd = nullptr;
+    bool m_redraw = true;
+};
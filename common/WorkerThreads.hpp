@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that run one job at a time, split into parts. The
+// calling thread runs the first part itself and waits for the others, so
+// there is one worker fewer than threads. Part i always runs on the same
+// thread, so parts may use per-thread resources indexed by part.
+class WorkerThreads {
+public:
+    // Runs part [0, partCount) of a job. It is called concurrently and must
+    // not touch shared state without synchronization.
+    using PartFunction = std::function<void(std::uint32_t part)>;
+
+    explicit WorkerThreads(
+        std::uint32_t threadCount = std::thread::hardware_concurrency())
+        : m_threadCount(std::max(threadCount, 1u))
+    {
+        for (std::uint32_t i = 1; i < m_threadCount; i++) {
+            m_workers.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    WorkerThreads(const WorkerThreads&) = delete;
+    WorkerThreads& operator=(const WorkerThreads&) = delete;
+
+    ~WorkerThreads()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_jobReady.notify_all();
+
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    std::uint32_t threadCount() const { return m_threadCount; }
+
+    // Runs runPart for each part, one part per thread, and rethrows the
+    // first exception once every part has returned. partCount is clamped to
+    // the number of threads.
+    void run(std::uint32_t partCount, const PartFunction& runPart)
+    {
+        partCount = std::min(partCount, m_threadCount);
+
+        if (partCount == 0) {
+            return;
+        }
+
+        if (partCount == 1) {
+            runPart(0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = { &runPart, partCount };
+            m_pending = partCount - 1;
+            m_error = nullptr;
+            m_generation++;
+        }
+        m_jobReady.notify_all();
+
+        std::exception_ptr error;
+
+        try {
+            runPart(0);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobDone.wait(lock, [this] { return m_pending == 0; });
+
+            if (!error) {
+                error = m_error;
+            }
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct Job {
+        const PartFunction* runPart = nullptr;
+        std::uint32_t partCount = 0;
+    };
+
+    void work(std::uint32_t thread)
+    {
+        std::uint64_t generation = 0;
+
+        while (true) {
+            Job job;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_jobReady.wait(lock,
+                    [&] { return m_stop || m_generation != generation; });
+
+                if (m_stop) {
+                    return;
+                }
+
+                generation = m_generation;
+                job = m_job;
+            }
+
+            if (thread >= job.partCount) {
+                continue;
+            }
+
+            std::exception_ptr error;
+
+            try {
+                (*job.runPart)(thread);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (error && !m_error) {
+                    m_error = error;
+                }
+
+                m_pending--;
+            }
+            m_jobDone.notify_one();
+        }
+    }
+
+    std::uint32_t m_threadCount;
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_jobReady;
+    std::condition_variable m_jobDone;
+    bool m_stop = false;
+    std::uint64_t m_generation = 0;
+    Job m_job;
+    std::uint32_t m_pending = 0;
+    std::exception_ptr m_error;
+};